@@ -1,5 +1,5 @@
-use criterion::{criterion_group, criterion_main, Criterion};
-use std::{env, path::PathBuf};
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use std::{env, path::PathBuf, thread};
 #[cfg(not(target_env = "msvc"))]
 use tikv_jemallocator::Jemalloc;
 
@@ -65,5 +65,198 @@ fn terrain_profile(c: &mut Criterion) {
     });
 }
 
-criterion_group!(benches, terrain_profile);
+fn tile_lookup(c: &mut Criterion) {
+    init_rfprop();
+
+    // Cells are visited row by row starting in the southern ocean.
+    // Tiles with no BSDF file on disk become sea-level placeholders,
+    // which grows the resident set without needing real terrain.
+    fn cell(n: usize) -> (f64, f64) {
+        let lat = (n / 360) as f64 - 60.0 + 0.5;
+        let lon = (n % 360) as f64 - 180.0 + 0.5;
+        (lat, lon)
+    }
+
+    let mut group = c.benchmark_group("Tile Lookup");
+    let mut resident = 0;
+
+    for tiles in [1, 10, 100, 1_000, 10_000] {
+        while resident < tiles {
+            let (lat, lon) = cell(resident);
+            rfprop::get_elevation(lat, lon);
+            resident += 1;
+        }
+
+        // Query the most recently registered tile, which is the
+        // worst case for a registry that scans in load order.
+        let (lat, lon) = cell(tiles - 1);
+        group.bench_with_input(BenchmarkId::from_parameter(tiles), &tiles, |b, _| {
+            b.iter(|| rfprop::get_elevation(lat, lon))
+        });
+    }
+}
+
+fn lookup_scaling(c: &mut Criterion) {
+    init_rfprop();
+
+    // Every thread builds the same profile, so they all sample the
+    // same tiles concurrently.
+    const PROFILES_PER_THREAD: u64 = 16;
+
+    let mut group = c.benchmark_group("Lookup Scaling");
+
+    for threads in [1, 4, 16, 64] {
+        group.throughput(Throughput::Elements(threads * PROFILES_PER_THREAD));
+        group.bench_with_input(
+            BenchmarkId::from_parameter(threads),
+            &threads,
+            |b, &threads| {
+                b.iter(|| {
+                    thread::scope(|s| {
+                        for _ in 0..threads {
+                            s.spawn(|| {
+                                for _ in 0..PROFILES_PER_THREAD {
+                                    rfprop::terrain_profile(
+                                        52.30693919915002,
+                                        -117.3519964316712,
+                                        0.0,
+                                        52.30866462880422,
+                                        -117.3165476765753,
+                                        0.0,
+                                        900e6,
+                                        true,
+                                    );
+                                }
+                            });
+                        }
+                    })
+                })
+            },
+        );
+    }
+}
+
+fn azimuth_sweep(c: &mut Criterion) {
+    init_rfprop();
+
+    // One radial per degree around a fixed transmitter. Run it against
+    // tiles written by `sdftool --format v0` and by `sdftool --format
+    // v1 --codec raw` to compare row-major and blocked layouts; on
+    // its own, under `perf stat -e cache-misses`, it shows the misses
+    // each layout takes.
+    const CENTER: (f64, f64) = (52.30693919915002, -117.3519964316712);
+    const RADIUS_KM: f64 = 30.0;
+    const KM_PER_DEGREE: f64 = 111.32;
+
+    let mut group = c.benchmark_group("Azimuth Sweep");
+    group.throughput(Throughput::Elements(360));
+    group.bench_function("30km", |b| {
+        b.iter(|| {
+            for azimuth in 0..360 {
+                let (sin, cos) = (azimuth as f64).to_radians().sin_cos();
+                let lat = CENTER.0 + RADIUS_KM * cos / KM_PER_DEGREE;
+                let lon =
+                    CENTER.1 + RADIUS_KM * sin / (KM_PER_DEGREE * CENTER.0.to_radians().cos());
+                rfprop::terrain_profile(CENTER.0, CENTER.1, 0.0, lat, lon, 0.0, 900e6, true);
+            }
+        })
+    });
+}
+
+fn sweep_scaling(c: &mut Criterion) {
+    init_rfprop();
+
+    // A 100km ITM plot swept by 1, 2, 4... threads, up to one per
+    // hardware thread. Every plot does the same work, so ideally the
+    // time halves as the threads double.
+    const PLOT_ARGS: &str = "-lat 41.491489 -lon -81.695537 -txh 10 -f 900 -erp 90 -rxh 10 -rt -140 -dbm -m -pm 1 -R 100";
+    let max_threads = thread::available_parallelism().map_or(1, |n| n.get());
+
+    let mut group = c.benchmark_group("Sweep Scaling");
+    group.sample_size(10);
+
+    for threads in (0..)
+        .map(|i| 1 << i)
+        .take_while(|&n| n < max_threads)
+        .chain([max_threads])
+    {
+        group.bench_with_input(
+            BenchmarkId::from_parameter(threads),
+            &threads,
+            |b, &threads| {
+                b.iter(|| {
+                    rfprop::call_sigserve(&format!("{PLOT_ARGS} -threads {threads}")).unwrap()
+                })
+            },
+        );
+    }
+}
+
+fn get_elevations(c: &mut Criterion) {
+    init_rfprop();
+
+    // 10k points about 10m apart along a 100km line, queried one at
+    // a time and in a single batch.
+    const POINTS: usize = 10_000;
+    let lats: Vec<f64> = (0..POINTS)
+        .map(|i| 52.30693919915002 + i as f64 * 9e-5 * 0.6)
+        .collect();
+    let lons: Vec<f64> = (0..POINTS)
+        .map(|i| -117.3519964316712 + i as f64 * 9e-5 * 0.8)
+        .collect();
+
+    let mut group = c.benchmark_group("Get Elevations");
+    group.throughput(Throughput::Elements(POINTS as u64));
+    group.bench_function("single", |b| {
+        b.iter(|| {
+            lats.iter()
+                .zip(&lons)
+                .map(|(&lat, &lon)| rfprop::get_elevation(lat, lon))
+                .sum::<f64>()
+        })
+    });
+    group.bench_function("batch", |b| {
+        b.iter(|| rfprop::get_elevations(&lats, &lons, false))
+    });
+    group.bench_function("batch bilinear", |b| {
+        b.iter(|| rfprop::get_elevations(&lats, &lons, true))
+    });
+}
+
+fn sight_angles(c: &mut Criterion) {
+    // The first obstruction seen from a 300ft mast to every point of a
+    // 100km radial over gently rolling terrain, which seldom blocks
+    // the view, so that each point's sight line crosses most of the
+    // terrain before it.
+    const RADIUS_KM: f64 = 100.0;
+    const MILES_PER_DEGREE: f64 = 69.09;
+
+    let mut group = c.benchmark_group("Sight Angles");
+
+    for ppd in [1200, 3600] {
+        let count = (RADIUS_KM / 111.2 * ppd as f64) as usize;
+        let distance: Vec<f64> = (0..count)
+            .map(|i| i as f64 * MILES_PER_DEGREE / ppd as f64)
+            .collect();
+        let terrain: Vec<f64> = (0..count)
+            .map(|i| 200.0 + 30.0 * (i as f64 / 97.0).sin() + 10.0 * (i as f64 / 13.0).sin())
+            .collect();
+
+        group.throughput(Throughput::Elements(count as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(ppd), &ppd, |b, _| {
+            b.iter(|| rfprop::sight_angles(&distance, &terrain, 300.0, 10.0, 0.0))
+        });
+    }
+}
+
+criterion_group!(
+    benches,
+    terrain_profile,
+    tile_lookup,
+    lookup_scaling,
+    azimuth_sweep,
+    sweep_scaling,
+    get_elevations,
+    sight_angles
+);
 criterion_main!(benches);
@@ -1,5 +1,12 @@
 fn main() {
     let cxx_sources = [
+        "../../src/bsdf.cc",
+        "../../src/coverage.cc",
+        "../../src/dem-cache.cc",
+        "../../src/dem-catalog.cc",
+        "../../src/dem-overview.cc",
+        "../../src/dem-shm.cc",
+        "../../src/great-circle.cc",
         "../../src/image-png.cc",
         "../../src/image-ppm.cc",
         "../../src/image.cc",
@@ -16,12 +23,20 @@ fn main() {
         "../../src/models/soil.cc",
         "../../src/models/sui.cc",
         "../../src/outputs.cc",
+        "../../src/sdf.cc",
         "../../src/signal-server.cc",
         "../../src/tiles.cc",
         "src/sigserve.cc",
     ];
     let cxx_headers = [
+        "../../src/bsdf.hh",
         "../../src/common.hh",
+        "../../src/coverage.hh",
+        "../../src/dem-cache.hh",
+        "../../src/dem-catalog.hh",
+        "../../src/dem-overview.hh",
+        "../../src/dem-shm.hh",
+        "../../src/great-circle.hh",
         "../../src/image-png.hh",
         "../../src/image-ppm.hh",
         "../../src/image.hh",
@@ -38,6 +53,7 @@ fn main() {
         "../../src/models/soil.hh",
         "../../src/models/sui.hh",
         "../../src/outputs.hh",
+        "../../src/sdf.hh",
         "../../src/signal-server.hh",
         "../../src/tiles.hh",
         "src/sigserve.h",
@@ -48,18 +64,29 @@ fn main() {
     for path in &cxx_sources {
         bridge.file(path);
     }
+    #[cfg(feature = "count_allocations")]
+    bridge.file("src/alloc-count.cc");
     #[cfg(feature = "address_sanitizer")]
     {
         bridge.flag("-fno-omit-frame-pointer");
         bridge.flag("-ggdb");
         bridge.flag("-fsanitize=address");
     }
+    #[cfg(feature = "thread_sanitizer")]
+    {
+        bridge.flag("-fno-omit-frame-pointer");
+        bridge.flag("-ggdb");
+        bridge.flag("-fsanitize=thread");
+    }
     bridge.compile("sigserve_wrapper");
     println!("cargo:rustc-link-lib=png");
+    println!("cargo:rustc-link-lib=bz2");
+    println!("cargo:rustc-link-lib=z");
 
     for path in cxx_sources.iter().chain(cxx_headers.iter()) {
         println!("cargo:rerun-if-changed={path}");
     }
 
+    println!("cargo:rerun-if-changed=src/alloc-count.cc");
     println!("cargo:rerun-if-changed=src/sigserve.rs");
 }
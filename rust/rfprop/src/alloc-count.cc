@@ -0,0 +1,162 @@
+/*
+ * Replaces C++'s operator new and delete, in every form, to count the
+ * allocations each thread makes, so tests can check that code paths
+ * stay off the heap.  Only built with the count_allocations feature,
+ * which only the allocations test needs; every binary linked against
+ * rfprop built with it allocates through here.  Allocation failures go
+ * to the new handler and then throw std::bad_alloc, as the standard
+ * library's operator new does.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <cstddef>
+#include <new>
+
+namespace {
+thread_local uint64_t G_allocations = 0;
+
+void * allocate(size_t size, size_t align) {
+    G_allocations++;
+
+    if (size == 0) {
+        size = 1;
+    }
+
+    for (;;) {
+        void * ptr = NULL;
+
+        if (align <= alignof(std::max_align_t)) {
+            ptr = malloc(size);
+        } else if (posix_memalign(&ptr, align, size) != 0) {
+            ptr = NULL;
+        }
+
+        if (ptr) {
+            return ptr;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+
+        handler();
+    }
+}
+} // namespace
+
+/*
+ * rfprop_cxx_allocations
+ * Returns how many times the calling thread has called operator new.
+ */
+extern "C" uint64_t rfprop_cxx_allocations() {
+    return G_allocations;
+}
+
+void * operator new(size_t size) {
+    return allocate(size, 0);
+}
+
+void * operator new[](size_t size) {
+    return allocate(size, 0);
+}
+
+void * operator new(size_t size, std::align_val_t align) {
+    return allocate(size, (size_t)align);
+}
+
+void * operator new[](size_t size, std::align_val_t align) {
+    return allocate(size, (size_t)align);
+}
+
+void * operator new(size_t size, std::nothrow_t const &) noexcept {
+    try {
+        return allocate(size, 0);
+    } catch (std::bad_alloc const &) {
+        return NULL;
+    }
+}
+
+void * operator new[](size_t size, std::nothrow_t const &) noexcept {
+    try {
+        return allocate(size, 0);
+    } catch (std::bad_alloc const &) {
+        return NULL;
+    }
+}
+
+void * operator new(size_t size,
+                    std::align_val_t align,
+                    std::nothrow_t const &) noexcept {
+    try {
+        return allocate(size, (size_t)align);
+    } catch (std::bad_alloc const &) {
+        return NULL;
+    }
+}
+
+void * operator new[](size_t size,
+                      std::align_val_t align,
+                      std::nothrow_t const &) noexcept {
+    try {
+        return allocate(size, (size_t)align);
+    } catch (std::bad_alloc const &) {
+        return NULL;
+    }
+}
+
+/* malloc() and posix_memalign() memory alike is released by free() */
+
+void operator delete(void * ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void * ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void * ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void * ptr, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void * ptr, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void * ptr, size_t, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void * ptr, size_t, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void * ptr, std::nothrow_t const &) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void * ptr, std::nothrow_t const &) noexcept {
+    free(ptr);
+}
+
+void operator delete(void * ptr,
+                     std::align_val_t,
+                     std::nothrow_t const &) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void * ptr,
+                       std::align_val_t,
+                       std::nothrow_t const &) noexcept {
+    free(ptr);
+}
@@ -3,9 +3,11 @@ mod sigserve;
 
 pub use error::Error;
 pub use sigserve::{
-    call_sigserve,
-    ffi::{Report, TerrainProfile},
-    get_elevation, init, terrain_profile,
+    add_hot_tiles, attach_shared_tile_cache, call_sigserve,
+    ffi::{GreatCircle, Report, TerrainProfile, TileCacheStats},
+    get_elevation, get_elevations, great_circle, image_pixels, init, itm_losses,
+    set_bsdf_cache_dir, set_tile_cache_budget, set_tile_policy, sight_angles, terrain_profile,
+    tile_cache_stats, watch_tile_dirs,
 };
 
 #[cfg(test)]
@@ -45,6 +47,42 @@ mod tests {
         println!("{p2p_report:?}");
     }
 
+    #[test]
+    fn test_concurrent_plots() {
+        // Plots run side by side, each sweeping on threads of its own,
+        // and must not disturb one another.
+        const PLOT_ARGS: &str =
+            "-lat 41.491489 -lon -81.695537 -txh 10 -f 900 -erp 90 -rxh 10 -rt -140 -dbm -m -R 10";
+        const MODELS: [u32; 2] = [1, 7];
+
+        crate::init(&bsdf_dir(), false).unwrap();
+
+        let plot = |pm: u32, threads: &str| {
+            crate::call_sigserve(&format!("{PLOT_ARGS} -pm {pm} {threads}"))
+                .unwrap()
+                .image_data
+        };
+        let serial: Vec<_> = MODELS.iter().map(|&pm| plot(pm, "-nothreads")).collect();
+
+        std::thread::scope(|scope| {
+            let plots: Vec<_> = (0..16)
+                .map(|i| {
+                    let pm = MODELS[i % MODELS.len()];
+                    let threads = if i < 8 { "-nothreads" } else { "-threads 4" };
+                    scope.spawn(move || (i, plot(pm, threads)))
+                })
+                .collect();
+
+            // Each pixel goes to the first radial, in sweep order, to
+            // analyse it, so a plot comes out the same on any number of
+            // threads and whatever else is running.
+            for handle in plots {
+                let (i, image) = handle.join().unwrap();
+                assert_eq!(image, serial[i % MODELS.len()], "plot {i}");
+            }
+        });
+    }
+
     #[test]
     fn test_terrain_profile() {
         crate::init(&bsdf_dir(), false).unwrap();
@@ -82,4 +120,242 @@ mod tests {
         let mt_washington_elev = crate::get_elevation(44.2705, -71.30325);
         assert_eq!(mt_washington_elev.trunc(), 1903.0);
     }
+
+    #[test]
+    fn test_get_elevations() {
+        crate::init(&bsdf_dir(), false).unwrap();
+
+        // A short walk east from Mt Washington's summit.
+        let lats = vec![44.2705; 100];
+        let lons: Vec<f64> = (0..100).map(|i| -71.30325 + i as f64 * 1e-4).collect();
+
+        let batch = crate::get_elevations(&lats, &lons, false);
+        for ((lat, lon), elev) in lats.iter().zip(&lons).zip(&batch) {
+            assert_eq!(*elev, crate::get_elevation(*lat, *lon));
+        }
+
+        let smooth = crate::get_elevations(&lats, &lons, true);
+        assert_eq!(smooth.len(), lats.len());
+        assert!((smooth[0] - batch[0]).abs() < 30.0);
+    }
+
+    // The positions the great circle at `azimuth` from (`lat`, `lon`)
+    // reaches after each `step`, solved afresh for every sample as
+    // paths used to be traced. All angles are in degrees.
+    fn solve_great_circle(
+        lat: f64,
+        lon: f64,
+        azimuth: f64,
+        step: f64,
+        count: usize,
+    ) -> Vec<(f64, f64)> {
+        use std::f64::consts::{FRAC_PI_2, PI, TAU};
+
+        let (lat1, lon1, azimuth) = (lat.to_radians(), (-lon).to_radians(), azimuth.to_radians());
+        let arccos = |x: f64, y: f64| {
+            if y > 0.0 {
+                (x / y).acos()
+            } else if y < 0.0 {
+                PI + (x / y).acos()
+            } else {
+                0.0
+            }
+        };
+
+        (0..count)
+            .map(|c| {
+                let beta = (step * c as f64).to_radians();
+                let lat2 =
+                    (lat1.sin() * beta.cos() + azimuth.cos() * beta.sin() * lat1.cos()).asin();
+                let num = beta.cos() - lat1.sin() * lat2.sin();
+                let den = lat1.cos() * lat2.cos();
+
+                let mut lon2 = if azimuth == 0.0 && beta > FRAC_PI_2 - lat1 {
+                    lon1 + PI
+                } else if (num / den).abs() > 1.0 {
+                    lon1
+                } else if PI - azimuth >= 0.0 {
+                    lon1 - arccos(num, den)
+                } else {
+                    lon1 + arccos(num, den)
+                };
+                lon2 = lon2.rem_euclid(TAU);
+
+                (lat2.to_degrees(), -lon2.to_degrees())
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_great_circle() {
+        // 300 km at 3600 samples per degree, every way out of Mt
+        // Washington's summit.
+        const PPD: f64 = 3600.0;
+        let step = 1.0 / PPD;
+        let count = (300.0 / 111.2 * PPD) as usize;
+
+        for azimuth in (0..360).step_by(15).map(f64::from) {
+            let traced = crate::great_circle(44.2705, -71.30325, azimuth, step, count);
+            let solved = solve_great_circle(44.2705, -71.30325, azimuth, step, count);
+            assert_eq!(traced.lat.len(), count);
+
+            for ((lat, lon), (solved_lat, solved_lon)) in
+                traced.lat.iter().zip(&traced.lon).zip(solved)
+            {
+                let lon_error = (lon - solved_lon).rem_euclid(360.0);
+                let lon_error = f64::min(lon_error, 360.0 - lon_error);
+                assert!(
+                    (lat - solved_lat).abs() * PPD < 0.05,
+                    "azimuth {azimuth}: {lat} vs {solved_lat}"
+                );
+                assert!(
+                    lon_error * PPD < 0.05,
+                    "azimuth {azimuth}: {lon} vs {solved_lon}"
+                );
+            }
+        }
+    }
+
+    // The angles `sight_angles` returns, found as plots used to find
+    // them: by scanning out from the transmitter to each point for the
+    // first that rises to meet the sight line to it.
+    fn scan_sight_angles(
+        distance: &[f64],
+        terrain: &[f64],
+        tx_alt: f64,
+        rx_alt: f64,
+        clutter: f64,
+    ) -> Vec<f64> {
+        const FOUR_THIRDS_EARTH: f64 = 1.3333333333333 * 20902230.97;
+        const FEET_PER_MILE: f64 = 5280.0;
+        const DEG2RAD: f64 = 1.74532925199e-02;
+
+        let xmtr_alt = FOUR_THIRDS_EARTH + tx_alt + terrain[0];
+        let cos_angle = |x: usize, alt: f64| {
+            let d = FEET_PER_MILE * distance[x];
+            ((xmtr_alt * xmtr_alt + d * d - alt * alt) / (2.0 * xmtr_alt * d)).clamp(-1.0, 1.0)
+        };
+        let degrees = |cos: f64| cos.acos() / DEG2RAD - 90.0;
+
+        (2..terrain.len())
+            .map(|y| {
+                let cos_rcvr = cos_angle(y, FOUR_THIRDS_EARTH + rx_alt + terrain[y]);
+                (2..y)
+                    .map(|x| {
+                        let top = if terrain[x] == 0.0 {
+                            0.0
+                        } else {
+                            terrain[x] + clutter
+                        };
+                        cos_angle(x, FOUR_THIRDS_EARTH + top)
+                    })
+                    .find(|&cos_test| cos_rcvr >= cos_test)
+                    .map_or(degrees(cos_rcvr), degrees)
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_sight_angles() {
+        crate::init(&bsdf_dir(), false).unwrap();
+
+        // 40 km every way out of Mt Washington's summit and from the
+        // valley below it, with masts and clutter from none to tall.
+        const PPD: f64 = 1200.0;
+        const MILES_PER_DEGREE: f64 = 69.09;
+        let count = (40.0 / 111.2 * PPD) as usize;
+        let distance: Vec<f64> = (0..count)
+            .map(|i| i as f64 * MILES_PER_DEGREE / PPD)
+            .collect();
+
+        for (lat, lon) in [(44.2705, -71.30325), (44.33, -71.18)] {
+            for azimuth in (0..360).step_by(10).map(f64::from) {
+                let path = crate::great_circle(lat, lon, azimuth, 1.0 / PPD, count);
+                let terrain: Vec<f64> = crate::get_elevations(&path.lat, &path.lon, false)
+                    .iter()
+                    .map(|m| m / 0.3048)
+                    .collect();
+
+                for (tx_alt, rx_alt, clutter) in [(30.0, 10.0, 0.0), (300.0, 30.0, 40.0)] {
+                    assert_eq!(
+                        crate::sight_angles(&distance, &terrain, tx_alt, rx_alt, clutter),
+                        scan_sight_angles(&distance, &terrain, tx_alt, rx_alt, clutter),
+                        "azimuth {azimuth} from ({lat}, {lon})"
+                    );
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_itm_losses() {
+        crate::init(&bsdf_dir(), false).unwrap();
+
+        // 40 km every way out of Mt Washington's summit, the valley
+        // below it and Cleveland, sampled as plots sample them at 1200
+        // and 3600 ppd. The mean height of the mountain radials' middles
+        // climbs and falls by hundreds of metres, which moves the
+        // earth's curvature ITM takes well past the window the radial
+        // analysis keeps hulls for, so those are rebuilt along the way.
+        const MILES: f64 = 40.0 / 1.609344;
+
+        for ppd in [1200.0, 3600.0] {
+            let count = (40.0 / 111.2 * ppd) as usize;
+            // Spaced as paths are, by the distance over the samples
+            // in it, so each spacing taken from two distances rounds
+            // differently from the first.
+            let step = MILES / (count - 1) as f64;
+            let distance: Vec<f64> = (0..count).map(|i| i as f64 * step).collect();
+
+            for (lat, lon) in [
+                (44.2705, -71.30325),
+                (44.33, -71.18),
+                (41.491489, -81.695537),
+            ] {
+                for azimuth in (0..360).step_by(45).map(f64::from) {
+                    let path = crate::great_circle(lat, lon, azimuth, 1.0 / ppd, count);
+                    let terrain: Vec<f64> = crate::get_elevations(&path.lat, &path.lon, true)
+                        .iter()
+                        .map(|m| m / 0.3048)
+                        .collect();
+
+                    for (tx_alt, rx_alt) in [(10.0, 3.0), (30.0, 10.0), (300.0, 30.0)] {
+                        for compact in [false, true] {
+                            let radial = crate::itm_losses(
+                                &distance, &terrain, tx_alt, rx_alt, compact, true,
+                            );
+                            let point = crate::itm_losses(
+                                &distance, &terrain, tx_alt, rx_alt, compact, false,
+                            );
+
+                            assert_eq!(radial.len(), count - 2);
+                            for (y, (a, b)) in radial.iter().zip(&point).enumerate() {
+                                assert!(
+                                    (a - b).abs() < 1e-6,
+                                    "{a} vs {b} dB at point {} of azimuth {azimuth} from \
+                                     ({lat}, {lon}) at {ppd} ppd, {tx_alt}/{rx_alt} ft, \
+                                     compact {compact}",
+                                    y + 1
+                                );
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_tile_cache_stats() {
+        crate::init(&bsdf_dir(), false).unwrap();
+
+        crate::get_elevation(44.2705, -71.30325);
+        let before = crate::tile_cache_stats();
+        crate::get_elevation(44.2705, -71.30325);
+        let after = crate::tile_cache_stats();
+
+        assert!(after.tiles >= 1);
+        assert!(after.hits > before.hits);
+        assert!(after.misses >= before.misses);
+    }
 }
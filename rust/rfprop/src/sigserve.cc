@@ -1,9 +1,20 @@
 #include "sigserve.h"
 
+#include <png.h>
+
 #include <algorithm>
 #include <cmath>
+#include <iterator>
+#include <string>
+#include <vector>
 
 #include "../../../src/common.hh"
+#include "../../../src/dem-cache.hh"
+#include "../../../src/dem-catalog.hh"
+#include "../../../src/dem-shm.hh"
+#include "../../../src/great-circle.hh"
+#include "../../../src/models/itwom3.0.hh"
+#include "../../../src/sdf.hh"
 #include "rfprop/src/sigserve.rs.h"
 
 extern int init(const char * sdf_path, bool debug);
@@ -12,9 +23,15 @@ extern int LoadTopoData(double max_lon,
                         double min_lon,
                         double max_lat,
                         double min_lat,
-                        struct output * out);
+                        struct output * out,
+                        bool readahead);
 extern double LonDiff(double lon1, double lon2);
-extern double GetElevation(site const & location);
+extern void GetElevations(struct dem_snapshot const & tiles,
+                          const double * lat,
+                          const double * lon,
+                          size_t count,
+                          double * elevation,
+                          bool bilinear);
 
 namespace sigserve_wrapper {
 
@@ -34,6 +51,8 @@ Report handle_args(int argc, char * argv[]) {
     report.dbm = out.dBm;
     report.loss = out.loss;
     report.field_strength = out.field_strength;
+    report.terrain_minor_faults = out.dem_faults.minor;
+    report.terrain_major_faults = out.dem_faults.major;
 
     report.cluttervec.reserve(out.cluttervec.size());
     std::copy(out.cluttervec.begin(),
@@ -78,6 +97,30 @@ Report handle_args(int argc, char * argv[]) {
     return report;
 }
 
+rust::Vec<uint8_t> image_pixels(rust::Slice<const uint8_t> image) {
+    rust::Vec<uint8_t> pixels;
+    std::vector<uint8_t> decoded;
+    png_image png = {};
+
+    png.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_memory(&png, image.data(), image.size())) {
+        return pixels;
+    }
+
+    png.format = PNG_FORMAT_RGBA;
+    decoded.resize(PNG_IMAGE_SIZE(png));
+
+    if (!png_image_finish_read(&png, NULL, decoded.data(), 0, NULL)) {
+        return pixels;
+    }
+
+    pixels.reserve(decoded.size());
+    std::copy(decoded.begin(), decoded.end(), std::back_inserter(pixels));
+
+    return pixels;
+}
+
 TerrainProfile terrain_profile(double tx_lat,
                                double tx_lon,
                                double tx_antenna_alt,
@@ -128,7 +171,7 @@ TerrainProfile terrain_profile(double tx_lat,
     double _min_lon = LonDiff(_tx_lon, _rx_lon) < 0.0 ? _tx_lon : _rx_lon;
     double _max_lon = LonDiff(_tx_lon, _rx_lon) < 0.0 ? _rx_lon : _tx_lon;
 
-    LoadTopoData(_max_lon, _min_lon, _max_lat, _min_lat, nullptr);
+    LoadTopoData(_max_lon, _min_lon, _max_lat, _min_lat, nullptr, false);
 
     site tx_site;
     tx_site.lat = tx_lat;
@@ -180,16 +223,247 @@ TerrainProfile terrain_profile(double tx_lat,
     return report;
 }
 
+static std::vector<double> sample_elevations(const double * lat,
+                                             const double * lon,
+                                             size_t count,
+                                             bool bilinear) {
+    std::vector<double> west(count), elevation(count);
+    double last_lat = NAN, last_lon = NAN;
+
+    for (size_t i = 0; i < count; i++) {
+        double _min_lat = std::floor(lat[i]);
+        double _min_lon = std::floor(-lon[i]);
+
+        // Points along a path mostly stay in one tile, so only ask
+        // for a tile when the point moves to another one.
+        if (_min_lat != last_lat || _min_lon != last_lon) {
+            LoadTopoData(
+                _min_lon, _min_lon, _min_lat, _min_lat, nullptr, false);
+            last_lat = _min_lat;
+            last_lon = _min_lon;
+        }
+
+        west[i] = -lon[i];
+    }
+
+    GetElevations(*dem_cache_snapshot(),
+                  lat,
+                  west.data(),
+                  count,
+                  elevation.data(),
+                  bilinear);
+
+    for (double & e : elevation) {
+        e *= METERS_PER_FOOT;
+    }
+
+    return elevation;
+}
+
 double get_elevation(double lat, double lon) {
-    double _min_lat = std::floor(lat);
-    double _min_lon = std::floor(-lon);
+    return sample_elevations(&lat, &lon, 1, false)[0];
+}
+
+rust::Vec<double> get_elevations(rust::Slice<const double> lat,
+                                 rust::Slice<const double> lon,
+                                 bool bilinear) {
+    size_t count = std::min(lat.size(), lon.size());
+    std::vector<double> elevation =
+        sample_elevations(lat.data(), lon.data(), count, bilinear);
+
+    rust::Vec<double> ret;
+    ret.reserve(count);
+    std::copy(elevation.begin(), elevation.end(), std::back_inserter(ret));
 
-    LoadTopoData(_min_lon, _min_lon, _min_lat, _min_lat, nullptr);
+    return ret;
+}
+
+GreatCircle great_circle(double lat,
+                         double lon,
+                         double azimuth,
+                         double step,
+                         size_t count) {
+    std::vector<double> lats(count), lons(count);
+    great_circle_trace(lat * DEG2RAD,
+                       -lon * DEG2RAD,
+                       azimuth * DEG2RAD,
+                       step * DEG2RAD,
+                       count,
+                       lats.data(),
+                       lons.data());
+
+    GreatCircle path;
+    path.lat.reserve(count);
+    std::copy(lats.begin(), lats.end(), std::back_inserter(path.lat));
+
+    // Back from [0,360) degrees west to (-180,180] east.
+    path.lon.reserve(count);
+    for (double west : lons) {
+        path.lon.push_back(west >= 180.0 ? 360.0 - west : -west);
+    }
+
+    return path;
+}
+
+rust::Vec<double> sight_angles(rust::Slice<const double> distance,
+                               rust::Slice<const double> terrain,
+                               double tx_alt,
+                               double rx_alt,
+                               double clutter) {
+    size_t count = std::min(distance.size(), terrain.size());
+    double four_thirds_earth = FOUR_THIRDS * EARTHRADIUS_FT;
+
+    // Only the distances and elevations are looked at.
+    Path path;
+    path.lat.assign(count, 0.0);
+    path.lon.assign(count, 0.0);
+    path.distance.assign(distance.begin(), distance.begin() + count);
+    path.elevation.assign(terrain.begin(), terrain.begin() + count);
+
+    rust::Vec<double> angles;
+    if (count < 3) {
+        return angles;
+    }
 
-    site loc;
-    loc.lat = lat;
-    loc.lon = -lon;
-    return GetElevation(loc) * METERS_PER_FOOT;
+    PathSight sight;
+    sight.start(four_thirds_earth + tx_alt + path.elevation[0],
+                four_thirds_earth,
+                clutter);
+
+    angles.reserve(count - 2);
+    for (size_t y = 2; y < count; y++) {
+        bool block;
+        angles.push_back(sight.elevation(
+            path, y, four_thirds_earth + rx_alt + path.elevation[y], block));
+    }
+
+    return angles;
+}
+
+rust::Vec<double> itm_losses(rust::Slice<const double> distance,
+                             rust::Slice<const double> terrain,
+                             double tx_alt,
+                             double rx_alt,
+                             bool compact,
+                             bool radial) {
+    size_t count = std::min(distance.size(), terrain.size());
+
+    // Laid out as plots lay out a radial's profile, out to each point
+    // in turn with the spacing to the point before it.
+    std::vector<double> elev(count + 2);
+    for (size_t x = 0; x < count; x++) {
+        elev[x + 2] = terrain[x] * METERS_PER_FOOT;
+    }
+    std::vector<float> heights(elev.begin(), elev.end());
+
+    rust::Vec<double> losses;
+    if (count < 3) {
+        return losses;
+    }
+
+    itm_radial itm;
+    itm.start();
+
+    auto loss = [&](auto const & profile) {
+        char strmode[100];
+        int errnum;
+        double dbloss;
+
+        if (radial) {
+            itm.point_to_point_ITM(tx_alt * METERS_PER_FOOT,
+                                   rx_alt * METERS_PER_FOOT,
+                                   15.0,
+                                   0.005,
+                                   301.0,
+                                   900.0,
+                                   5,
+                                   1,
+                                   0.5,
+                                   0.5,
+                                   dbloss,
+                                   strmode,
+                                   profile,
+                                   errnum);
+        } else {
+            point_to_point_ITM(tx_alt * METERS_PER_FOOT,
+                               rx_alt * METERS_PER_FOOT,
+                               15.0,
+                               0.005,
+                               301.0,
+                               900.0,
+                               5,
+                               1,
+                               0.5,
+                               0.5,
+                               dbloss,
+                               strmode,
+                               profile,
+                               errnum);
+        }
+
+        return dbloss;
+    };
+
+    losses.reserve(count - 2);
+    for (size_t y = 2; y < count; y++) {
+        elev[0] = y - 1;
+        elev[1] = METERS_PER_MILE * (distance[y] - distance[y - 1]);
+
+        if (compact) {
+            losses.push_back(
+                loss(float_profile{elev[0], elev[1], heights.data()}));
+        } else {
+            losses.push_back(loss(elev.data()));
+        }
+    }
+
+    return losses;
+}
+
+void set_tile_cache_budget(size_t max_tiles, size_t max_bytes) {
+    dem_cache_set_budget(max_tiles, max_bytes);
+}
+
+void set_tile_policy(bool populate, bool hugepages) {
+    dem_cache_set_policy((populate ? DEM_POLICY_POPULATE : 0)
+                         | (hugepages ? DEM_POLICY_HUGEPAGE : 0));
+}
+
+void add_hot_tiles(double lat, double lon, double radius_km) {
+    dem_cache_add_hot(lat, -lon, radius_km);
+}
+
+int attach_shared_tile_cache(rust::Str name) {
+    return dem_shm_attach(std::string(name).c_str());
+}
+
+int set_bsdf_cache_dir(rust::Str dir) {
+    int err = sdf_set_cache_path(std::string(dir).c_str());
+
+    /* The tile catalogue lists the cache directory too */
+    return err ? err : dem_catalog_scan();
+}
+
+int watch_tile_dirs() {
+    return dem_catalog_watch();
+}
+
+TileCacheStats tile_cache_stats() {
+    struct dem_cache_stats stats;
+    struct sdf_stats transcoded;
+    dem_cache_get_stats(&stats);
+    sdf_get_stats(&transcoded);
+
+    TileCacheStats report;
+    report.hits = stats.hits;
+    report.misses = stats.misses;
+    report.evictions = stats.evictions;
+    report.tiles = stats.tiles;
+    report.bytes = stats.bytes;
+    report.transcoded_tiles = transcoded.tiles;
+    report.transcoded_bytes = transcoded.text_bytes;
+    report.transcode_seconds = transcoded.seconds;
+    return report;
 }
 
 } // namespace sigserve_wrapper
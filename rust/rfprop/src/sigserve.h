@@ -4,12 +4,34 @@
 
 namespace sigserve_wrapper {
 
+struct GreatCircle;
 struct Report;
 struct TerrainProfile;
+struct TileCacheStats;
 
 int init(const char * sdf_path, bool debug);
 double get_elevation(double lat, double lon);
+rust::Vec<double> get_elevations(rust::Slice<const double> lat,
+                                 rust::Slice<const double> lon,
+                                 bool bilinear);
+GreatCircle great_circle(double lat,
+                         double lon,
+                         double azimuth,
+                         double step,
+                         size_t count);
+rust::Vec<double> sight_angles(rust::Slice<const double> distance,
+                               rust::Slice<const double> terrain,
+                               double tx_alt,
+                               double rx_alt,
+                               double clutter);
+rust::Vec<double> itm_losses(rust::Slice<const double> distance,
+                             rust::Slice<const double> terrain,
+                             double tx_alt,
+                             double rx_alt,
+                             bool compact,
+                             bool radial);
 Report handle_args(int argc, char * argv[]);
+rust::Vec<uint8_t> image_pixels(rust::Slice<const uint8_t> image);
 TerrainProfile terrain_profile(double tx_lat,
                                double tx_lon,
                                double tx_antenna_alt_m,
@@ -19,6 +41,13 @@ TerrainProfile terrain_profile(double tx_lat,
                                double freq_hz,
                                bool normalize,
                                bool metric);
+void set_tile_cache_budget(size_t max_tiles, size_t max_bytes);
+void set_tile_policy(bool populate, bool hugepages);
+void add_hot_tiles(double lat, double lon, double radius_km);
+int attach_shared_tile_cache(rust::Str name);
+int set_bsdf_cache_dir(rust::Str dir);
+int watch_tile_dirs();
+TileCacheStats tile_cache_stats();
 
 } // namespace sigserve_wrapper
 
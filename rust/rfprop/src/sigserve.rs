@@ -45,6 +45,85 @@ pub fn get_elevation(lat: f64, lon: f64) -> f64 {
     unsafe { ffi::get_elevation(lat, lon) }
 }
 
+/// Returns the elevation in meters at each `(lats[i], lons[i])`.
+///
+/// All points are sampled in one call, and consecutive points in the
+/// same tile share its lookup, so points along a path are cheapest.
+/// With `bilinear` set, elevations are interpolated between the four
+/// nearest samples instead of taken from the nearest one.
+pub fn get_elevations(lats: &[f64], lons: &[f64], bilinear: bool) -> Vec<f64> {
+    assert!(
+        INITIALIZED.is_completed(),
+        "must init rfprop with tile path"
+    );
+    assert_eq!(lats.len(), lons.len(), "need one longitude per latitude");
+    // SAFETY: See previous safety comment.
+    unsafe { ffi::get_elevations(lats, lons, bilinear) }
+}
+
+/// Returns the `count` positions reached from (`lat`, `lon`) by going
+/// 0, `step`, 2 `step`... degrees of arc along the great circle that
+/// sets off on `azimuth` degrees from north.
+///
+/// These are the positions that terrain profiles are sampled at.
+pub fn great_circle(lat: f64, lon: f64, azimuth: f64, step: f64, count: usize) -> ffi::GreatCircle {
+    // SAFETY: See previous safety comment.
+    unsafe { ffi::great_circle(lat, lon, azimuth, step, count) }
+}
+
+/// Returns the elevation angle, in degrees, at which a transmitter
+/// `tx_alt` feet above the start of a terrain profile sees a receiver
+/// `rx_alt` feet above each point from the third on, or else the
+/// angle of the first point between them that rises to meet that
+/// sight line.
+///
+/// `distance` is in miles from the start and `terrain` in feet, and
+/// points other than the ends stand `clutter` feet higher unless at
+/// sea level. Earth's curvature is taken as 4/3 of its radius, as
+/// plots do when applying an antenna's elevation pattern.
+pub fn sight_angles(
+    distance: &[f64],
+    terrain: &[f64],
+    tx_alt: f64,
+    rx_alt: f64,
+    clutter: f64,
+) -> Vec<f64> {
+    assert_eq!(
+        distance.len(),
+        terrain.len(),
+        "need one elevation per distance"
+    );
+    // SAFETY: See previous safety comment.
+    unsafe { ffi::sight_angles(distance, terrain, tx_alt, rx_alt, clutter) }
+}
+
+/// Returns the ITM path loss, in dB, from a transmitter `tx_alt` feet
+/// above the start of a terrain profile to a receiver `rx_alt` feet
+/// above each point from the second to the last but one, over average
+/// ground at 900 MHz, found as plots find it: with the profile out to
+/// each point in turn, spaced as the point after it is from that one.
+///
+/// `distance` is in miles from the start and `terrain` in feet. With
+/// `compact`, the heights are taken in float, as `-cpfl` takes them;
+/// with `radial`, each profile is analysed carrying on from the one
+/// before, as full resolution plot profiles are.
+pub fn itm_losses(
+    distance: &[f64],
+    terrain: &[f64],
+    tx_alt: f64,
+    rx_alt: f64,
+    compact: bool,
+    radial: bool,
+) -> Vec<f64> {
+    assert_eq!(
+        distance.len(),
+        terrain.len(),
+        "need one elevation per distance"
+    );
+    // SAFETY: See previous safety comment.
+    unsafe { ffi::itm_losses(distance, terrain, tx_alt, rx_alt, compact, radial) }
+}
+
 pub fn call_sigserve(args: &str) -> Result<ffi::Report, Error> {
     assert!(
         INITIALIZED.is_completed(),
@@ -69,6 +148,14 @@ pub fn call_sigserve(args: &str) -> Result<ffi::Report, Error> {
     }
 }
 
+/// Decodes a plot's `image_data` into its pixels, four bytes of red,
+/// green, blue and alpha each, row by row from the top. Returns
+/// nothing if the image isn't a PNG.
+pub fn image_pixels(image: &[u8]) -> Vec<u8> {
+    // SAFETY: See previous safety comment.
+    unsafe { ffi::image_pixels(image) }
+}
+
 #[allow(clippy::too_many_arguments)]
 pub fn terrain_profile(
     tx_lat: f64,
@@ -105,6 +192,83 @@ pub fn terrain_profile(
     ret
 }
 
+/// Limits how many terrain tiles stay resident between requests.
+///
+/// Either limit may be zero to leave it unbounded. Once over budget,
+/// the least recently used tiles that no request is still reading
+/// are unmapped.
+pub fn set_tile_cache_budget(max_tiles: usize, max_bytes: usize) {
+    // SAFETY: See previous safety comment.
+    unsafe { ffi::set_tile_cache_budget(max_tiles, max_bytes) }
+}
+
+/// Sets how terrain tiles are mapped as they are loaded.
+///
+/// `populate` faults a tile's pages in while it is loaded rather than
+/// on first touch during a request. `hugepages` asks the kernel to
+/// back tiles with transparent huge pages where it can.
+pub fn set_tile_policy(populate: bool, hugepages: bool) {
+    // SAFETY: See previous safety comment.
+    unsafe { ffi::set_tile_policy(populate, hugepages) }
+}
+
+/// Marks the tiles within `radius_km` of (`lat`, `lon`) as hot.
+///
+/// Hot tiles are locked in memory when they are loaded and are never
+/// evicted, e.g. for tiles around fixed sites that most requests use.
+pub fn add_hot_tiles(lat: f64, lon: f64, radius_km: f64) {
+    // SAFETY: See previous safety comment.
+    unsafe { ffi::add_hot_tiles(lat, lon, radius_km) }
+}
+
+/// Attaches to the host-wide shared tile cache called `name`,
+/// creating it if no process has yet.
+///
+/// Compressed tiles are then decoded once per host, into shared
+/// memory that every attached process maps, rather than once in every
+/// process. Attach before loading any tiles.
+pub fn attach_shared_tile_cache(name: &str) -> Result<(), Error> {
+    // SAFETY: See previous safety comment.
+    match unsafe { ffi::attach_shared_tile_cache(name) } {
+        0 => Ok(()),
+        other => Err(Error::Retcode(other)),
+    }
+}
+
+/// Sets the directory that legacy SDF tiles are transcoded into.
+///
+/// Tiles found only as `.sdf`, `.sdf.gz` or `.sdf.bz2` files are
+/// converted to BSDF the first time they are loaded, and the copy is
+/// loaded from then on. Copies go into the `init` directory unless
+/// this is set. Set it before loading any tiles.
+pub fn set_bsdf_cache_dir(dir: &Path) -> Result<(), Error> {
+    // SAFETY: See previous safety comment.
+    match unsafe { ffi::set_bsdf_cache_dir(&dir.to_string_lossy()) } {
+        0 => Ok(()),
+        other => Err(Error::Retcode(other)),
+    }
+}
+
+/// Keeps the catalogue of tiles on disk up to date as tiles are
+/// added to or removed from the tile directories.
+///
+/// The catalogue is made by `init`, and tiles it has no file for are
+/// treated as sea level without looking for them. Without watching,
+/// tiles added after `init` are not seen.
+pub fn watch_tile_dirs() -> Result<(), Error> {
+    // SAFETY: See previous safety comment.
+    match unsafe { ffi::watch_tile_dirs() } {
+        0 => Ok(()),
+        other => Err(Error::Retcode(other)),
+    }
+}
+
+/// Returns the terrain tile cache's counters and current residency.
+pub fn tile_cache_stats() -> ffi::TileCacheStats {
+    // SAFETY: See previous safety comment.
+    unsafe { ffi::tile_cache_stats() }
+}
+
 #[cxx::bridge(namespace = "sigserve_wrapper")]
 pub(crate) mod ffi {
     #[derive(Default, Debug)]
@@ -115,6 +279,9 @@ pub(crate) mod ffi {
         dbm: f64,
         loss: f64,
         field_strength: f64,
+        // page faults taken loading and sampling terrain
+        terrain_minor_faults: u64,
+        terrain_major_faults: u64,
         distancevec: Vec<f64>,
         cluttervec: Vec<f64>,
         line_of_sight: Vec<f64>,
@@ -140,6 +307,30 @@ pub(crate) mod ffi {
         tx_site_over_water: bool,
     }
 
+    #[derive(Default, Debug)]
+    pub struct GreatCircle {
+        lat: Vec<f64>,
+        lon: Vec<f64>,
+    }
+
+    #[derive(Default, Debug, Clone, Copy)]
+    pub struct TileCacheStats {
+        // tile lookups answered from memory
+        hits: u64,
+        // tiles that had to be loaded
+        misses: u64,
+        // tiles dropped to stay within budget
+        evictions: u64,
+        // currently resident tiles and their elevation bytes
+        tiles: usize,
+        bytes: usize,
+        // legacy SDF tiles transcoded to BSDF, the text they held
+        // and the time spent transcoding them
+        transcoded_tiles: u64,
+        transcoded_bytes: u64,
+        transcode_seconds: f64,
+    }
+
     unsafe extern "C++" {
         include!("rfprop/src/sigserve.h");
 
@@ -147,8 +338,37 @@ pub(crate) mod ffi {
 
         unsafe fn get_elevation(lat: f64, lon: f64) -> f64;
 
+        unsafe fn get_elevations(lat: &[f64], lon: &[f64], bilinear: bool) -> Vec<f64>;
+
+        unsafe fn great_circle(
+            lat: f64,
+            lon: f64,
+            azimuth: f64,
+            step: f64,
+            count: usize,
+        ) -> GreatCircle;
+
+        unsafe fn sight_angles(
+            distance: &[f64],
+            terrain: &[f64],
+            tx_alt: f64,
+            rx_alt: f64,
+            clutter: f64,
+        ) -> Vec<f64>;
+
+        unsafe fn itm_losses(
+            distance: &[f64],
+            terrain: &[f64],
+            tx_alt: f64,
+            rx_alt: f64,
+            compact: bool,
+            radial: bool,
+        ) -> Vec<f64>;
+
         unsafe fn handle_args(argc: i32, argv: *mut *mut c_char) -> Report;
 
+        unsafe fn image_pixels(image: &[u8]) -> Vec<u8>;
+
         #[allow(clippy::too_many_arguments)]
         unsafe fn terrain_profile(
             tx_lat: f64,
@@ -161,5 +381,19 @@ pub(crate) mod ffi {
             normalize: bool,
             metric: bool,
         ) -> TerrainProfile;
+
+        unsafe fn set_tile_cache_budget(max_tiles: usize, max_bytes: usize);
+
+        unsafe fn set_tile_policy(populate: bool, hugepages: bool);
+
+        unsafe fn add_hot_tiles(lat: f64, lon: f64, radius_km: f64);
+
+        unsafe fn attach_shared_tile_cache(name: &str) -> i32;
+
+        unsafe fn set_bsdf_cache_dir(dir: &str) -> i32;
+
+        unsafe fn watch_tile_dirs() -> i32;
+
+        unsafe fn tile_cache_stats() -> TileCacheStats;
     }
 }
@@ -0,0 +1,59 @@
+//! Counts the C++ heap allocations plots make. The count_allocations
+//! feature this needs replaces C++'s `operator new` for the whole
+//! binary, so this runs as a test binary of its own:
+//!
+//! ```text
+//! cargo test --features count_allocations --test allocations
+//! ```
+
+use std::{fs, path::PathBuf};
+
+extern "C" {
+    // Calls to `operator new` the calling thread has made
+    fn rfprop_cxx_allocations() -> u64;
+}
+
+fn cxx_allocations() -> u64 {
+    // SAFETY: only reads this thread's count.
+    unsafe { rfprop_cxx_allocations() }
+}
+
+fn bsdf_dir() -> PathBuf {
+    std::env::var("BSDF_DIR")
+        .map(PathBuf::from)
+        .ok()
+        .or_else(|| {
+            Some(
+                [env!("CARGO_MANIFEST_DIR"), "..", "..", "data"]
+                    .iter()
+                    .collect::<PathBuf>(),
+            )
+        })
+        .map(|p| fs::canonicalize(p).unwrap())
+        .unwrap()
+}
+
+#[test]
+fn test_sweep_allocations() {
+    // Every plot sweeps radials out to each pixel on the edge of
+    // the loaded terrain, as far as the radius.
+    const SWEEP_ARGS: &str = "-lat 41.491489 -lon -81.695537 -txh 10 -f 900 -erp 90 -rxh 10 -rt -140 -dbm -m -pm 1 -nothreads";
+
+    rfprop::init(&bsdf_dir(), false).unwrap();
+
+    let allocations = |radius: u32| {
+        let before = cxx_allocations();
+        rfprop::call_sigserve(&format!("{SWEEP_ARGS} -R {radius}")).unwrap();
+        cxx_allocations() - before
+    };
+
+    // Let the buffers grow to the longest radials first.
+    allocations(20);
+
+    // Thousands of radials, each analysed at up to hundreds of
+    // points, and a few allocations per plot for its image.
+    for radius in [5, 10, 20] {
+        let count = allocations(radius);
+        assert!(count < 100, "{count} allocations at radius {radius}");
+    }
+}
@@ -0,0 +1,285 @@
+//! BSDF v1 chunk codecs.
+//!
+//! Raw chunks hold their samples as little-endian `i16`, which lays
+//! the tile out in cache-friendly blocks. Compressed chunks are
+//! predicted with the LOCO-I median edge detector, zigzagged and Rice
+//! coded MSB first. In either codec, a chunk whose samples are all the
+//! same is stored as just that value. See `src/bsdf.cc` for the
+//! decoder and the full file layout.
+
+/// Quotients this long are escaped to a raw residual.
+const RICE_ESCAPE: u32 = 24;
+const RICE_RAW_BITS: u32 = 17;
+const MAX_RICE_K: u32 = 16;
+
+pub const CODEC_RAW: u16 = 0;
+pub const CODEC_MED_RICE: u16 = 1;
+
+/// Returns the median edge detector's prediction for sample `(x, y)`
+/// of a `w` wide chunk, given the samples decoded so far.
+fn predict(x: usize, y: usize, w: usize, samples: &[i16]) -> i32 {
+    if y == 0 {
+        return if x == 0 { 0 } else { samples[x - 1] as i32 };
+    }
+    if x == 0 {
+        return samples[(y - 1) * w] as i32;
+    }
+    let a = samples[y * w + x - 1] as i32;
+    let b = samples[(y - 1) * w + x] as i32;
+    let c = samples[(y - 1) * w + x - 1] as i32;
+    if c >= a.max(b) {
+        a.min(b)
+    } else if c <= a.min(b) {
+        a.max(b)
+    } else {
+        a + b - c
+    }
+}
+
+fn zigzag(e: i32) -> u32 {
+    ((e << 1) ^ (e >> 31)) as u32
+}
+
+fn rice_bits(u: u32, k: u32) -> u64 {
+    let q = u >> k;
+    if q < RICE_ESCAPE {
+        (q + 1 + k) as u64
+    } else {
+        (RICE_ESCAPE + RICE_RAW_BITS) as u64
+    }
+}
+
+struct BitWriter<'a> {
+    out: &'a mut Vec<u8>,
+    acc: u64,
+    count: u32,
+}
+
+impl<'a> BitWriter<'a> {
+    fn new(out: &'a mut Vec<u8>) -> Self {
+        Self {
+            out,
+            acc: 0,
+            count: 0,
+        }
+    }
+
+    fn put(&mut self, value: u32, bits: u32) {
+        if bits == 0 {
+            return;
+        }
+        self.acc = (self.acc << bits) | (value as u64 & ((1 << bits) - 1));
+        self.count += bits;
+        while self.count >= 8 {
+            self.count -= 8;
+            self.out.push((self.acc >> self.count) as u8);
+        }
+    }
+
+    fn finish(self) {
+        if self.count > 0 {
+            self.out.push((self.acc << (8 - self.count)) as u8);
+        }
+    }
+}
+
+/// Appends the `w` x `h` row-major `samples` to `out` as one chunk.
+pub fn encode_chunk(samples: &[i16], w: usize, h: usize, out: &mut Vec<u8>) {
+    assert_eq!(samples.len(), w * h);
+    let mut residuals = Vec::with_capacity(samples.len());
+    for y in 0..h {
+        for x in 0..w {
+            let e = samples[y * w + x] as i32 - predict(x, y, w, samples);
+            residuals.push(zigzag(e));
+        }
+    }
+
+    let k = (0..=MAX_RICE_K)
+        .min_by_key(|&k| residuals.iter().map(|&u| rice_bits(u, k)).sum::<u64>())
+        .unwrap();
+
+    out.push(k as u8);
+    let mut bits = BitWriter::new(out);
+    for u in residuals {
+        let q = u >> k;
+        if q < RICE_ESCAPE {
+            bits.put(u32::MAX, q);
+            bits.put(0, 1);
+            bits.put(u, k);
+        } else {
+            bits.put(u32::MAX, RICE_ESCAPE);
+            bits.put(u, RICE_RAW_BITS);
+        }
+    }
+    bits.finish();
+}
+
+/// Appends `samples` to `out` as a uniform chunk if they all have the
+/// same value, and returns whether they did.
+pub fn store_uniform(samples: &[i16], out: &mut Vec<u8>) -> bool {
+    match samples.split_first() {
+        Some((first, rest)) if rest.iter().all(|s| s == first) => {
+            out.extend_from_slice(&first.to_le_bytes());
+            true
+        }
+        _ => false,
+    }
+}
+
+/// Appends the row-major `samples` to `out` as one raw chunk.
+pub fn store_chunk(samples: &[i16], out: &mut Vec<u8>) {
+    for sample in samples {
+        out.extend_from_slice(&sample.to_le_bytes());
+    }
+}
+
+/// Splits an `ippd` x `ippd` tile into `dim` x `dim` chunks, row by
+/// row, and returns the concatenated chunks in the given codec along
+/// with the `n + 1` offsets delimiting them.
+pub fn encode_tile(samples: &[i16], ippd: usize, dim: usize, codec: u16) -> (Vec<u8>, Vec<u32>) {
+    assert!(dim.is_power_of_two());
+    let per_row = (ippd + dim - 1) / dim;
+    let mut data = Vec::new();
+    let mut offsets = Vec::with_capacity(per_row * per_row + 1);
+    let mut chunk = Vec::with_capacity(dim * dim);
+    for cy in 0..per_row {
+        for cx in 0..per_row {
+            let w = dim.min(ippd - cx * dim);
+            let h = dim.min(ippd - cy * dim);
+            chunk.clear();
+            for y in cy * dim..cy * dim + h {
+                chunk.extend_from_slice(&samples[y * ippd + cx * dim..][..w]);
+            }
+            offsets.push(data.len() as u32);
+            if store_uniform(&chunk, &mut data) {
+                continue;
+            }
+            match codec {
+                CODEC_RAW => store_chunk(&chunk, &mut data),
+                _ => encode_chunk(&chunk, w, h, &mut data),
+            }
+        }
+    }
+    offsets.push(data.len() as u32);
+    (data, offsets)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn unzigzag(u: u32) -> i32 {
+        (u >> 1) as i32 ^ -((u & 1) as i32)
+    }
+
+    struct BitReader<'a> {
+        data: &'a [u8],
+        pos: usize,
+    }
+
+    impl<'a> BitReader<'a> {
+        fn bits(&mut self, n: u32) -> u32 {
+            let mut v = 0;
+            for _ in 0..n {
+                let byte = self.data.get(self.pos / 8).copied().unwrap_or(0);
+                v = (v << 1) | ((byte >> (7 - self.pos % 8)) & 1) as u32;
+                self.pos += 1;
+            }
+            v
+        }
+    }
+
+    /// Decodes one chunk produced by [`encode_chunk`].
+    fn decode_chunk(chunk: &[u8], w: usize, h: usize) -> Vec<i16> {
+        let k = chunk.first().copied().unwrap_or(0) as u32 & 0x1f;
+        let mut bits = BitReader {
+            data: chunk.get(1..).unwrap_or(&[]),
+            pos: 0,
+        };
+        let mut samples = vec![0i16; w * h];
+        for y in 0..h {
+            for x in 0..w {
+                let mut q = 0;
+                while q < RICE_ESCAPE && bits.bits(1) == 1 {
+                    q += 1;
+                }
+                let u = if q < RICE_ESCAPE {
+                    (q << k) | bits.bits(k)
+                } else {
+                    bits.bits(RICE_RAW_BITS)
+                };
+                samples[y * w + x] = (predict(x, y, w, &samples) + unzigzag(u)) as i16;
+            }
+        }
+        samples
+    }
+
+    fn terrain(w: usize, h: usize) -> Vec<i16> {
+        (0..w * h)
+            .map(|i| {
+                let (x, y) = ((i % w) as f64, (i / w) as f64);
+                (300.0 * (x / 7.0).sin() + 200.0 * (y / 11.0).cos() + x * y / 50.0) as i16
+            })
+            .collect()
+    }
+
+    #[test]
+    fn round_trips_terrain() {
+        let samples = terrain(64, 64);
+        let mut out = Vec::new();
+        encode_chunk(&samples, 64, 64, &mut out);
+        assert!(out.len() < samples.len() * 2);
+        assert_eq!(decode_chunk(&out, 64, 64), samples);
+    }
+
+    #[test]
+    fn round_trips_extremes() {
+        // Alternating extremes force every residual through the escape.
+        let samples: Vec<i16> = (0..40 * 24)
+            .map(|i| if i % 3 == 0 { i16::MIN } else { i16::MAX })
+            .collect();
+        let mut out = Vec::new();
+        encode_chunk(&samples, 40, 24, &mut out);
+        assert_eq!(decode_chunk(&out, 40, 24), samples);
+    }
+
+    #[test]
+    fn splits_partial_edge_chunks() {
+        let ippd = 100;
+        let samples = terrain(ippd, ippd);
+        let (data, offsets) = encode_tile(&samples, ippd, 64, CODEC_MED_RICE);
+        assert_eq!(offsets.len(), 5);
+        let corner = &data[offsets[3] as usize..offsets[4] as usize];
+        let decoded = decode_chunk(corner, 36, 36);
+        assert_eq!(decoded[0], samples[64 * ippd + 64]);
+        assert_eq!(decoded[36 * 36 - 1], samples[ippd * ippd - 1]);
+    }
+
+    #[test]
+    fn stores_uniform_chunks_as_their_value() {
+        let ippd = 100;
+        let mut samples = terrain(ippd, ippd);
+        for y in 0..64 {
+            samples[y * ippd..][..64].fill(-7);
+        }
+        for codec in [CODEC_RAW, CODEC_MED_RICE] {
+            let (data, offsets) = encode_tile(&samples, ippd, 64, codec);
+            assert_eq!(offsets[1] - offsets[0], 2);
+            assert_eq!(i16::from_le_bytes([data[0], data[1]]), -7);
+            assert!(offsets[2] - offsets[1] > 2);
+        }
+    }
+
+    #[test]
+    fn stores_raw_blocks() {
+        let ippd = 100;
+        let samples = terrain(ippd, ippd);
+        let (data, offsets) = encode_tile(&samples, ippd, 64, CODEC_RAW);
+        assert_eq!(offsets, [0, 8192, 8192 + 4608, 8192 + 2 * 4608, 20000]);
+        let corner = &data[offsets[3] as usize..offsets[4] as usize];
+        let first = i16::from_le_bytes([corner[0], corner[1]]);
+        assert_eq!(first, samples[64 * ippd + 64]);
+        let second_row = i16::from_le_bytes([corner[72], corner[73]]);
+        assert_eq!(second_row, samples[65 * ippd + 64]);
+    }
+}
@@ -1,6 +1,8 @@
+mod codec;
+
 use anyhow::{anyhow, Result};
 use byteorder::{WriteBytesExt, LE};
-use clap::Parser;
+use clap::{Parser, ValueEnum};
 use rayon::prelude::*;
 use std::{
     convert::TryFrom,
@@ -23,6 +25,15 @@ struct Opts {
     /// Output directory
     #[arg(short, long)]
     out: Option<PathBuf>,
+    /// BSDF version to write
+    #[arg(short, long, value_enum, default_value_t = BsdfVersion::V0)]
+    format: BsdfVersion,
+    /// Edge length of v1 chunks, in samples
+    #[arg(short, long, default_value_t = 64)]
+    chunk: u16,
+    /// How v1 chunks are stored
+    #[arg(long, value_enum, default_value_t = ChunkCodec::MedRice)]
+    codec: ChunkCodec,
 }
 
 fn main() {
@@ -40,6 +51,10 @@ fn go() -> anyhow::Result<()> {
         .or_else(|_| std::env::current_dir())
         .map_err(|_| anyhow!("no outdir"))?;
     let resolution = Resolution::from_raw(opts.resolution)?;
+    let (format, chunk, codec) = (opts.format, opts.chunk, opts.codec);
+    if !(8..=256).contains(&chunk) || !chunk.is_power_of_two() {
+        return Err(anyhow!("invalid chunk size {chunk}"));
+    }
     let mut work_items: Vec<(BufReader<File>, BufWriter<File>)> =
         Vec::with_capacity(opts.input.len());
     for sdf_src in opts.input {
@@ -58,13 +73,26 @@ fn go() -> anyhow::Result<()> {
     }
     work_items
         .into_par_iter()
-        .try_for_each(|(src, dst)| sdf_to_bsdf(resolution, src, dst))?;
+        .try_for_each(|(src, dst)| sdf_to_bsdf(resolution, format, chunk, codec, src, dst))?;
     Ok(())
 }
 
+#[derive(Clone, Copy, Debug, ValueEnum)]
 #[repr(u8)]
 enum BsdfVersion {
+    /// Raw samples
     V0,
+    /// Compressed chunks
+    V1,
+}
+
+#[derive(Clone, Copy, Debug, ValueEnum)]
+#[repr(u16)]
+enum ChunkCodec {
+    /// Uncompressed samples, i.e. a blocked layout
+    Raw = codec::CODEC_RAW,
+    /// Median edge prediction and Rice coding
+    MedRice = codec::CODEC_MED_RICE,
 }
 
 #[derive(Clone, Copy, Debug)]
@@ -94,7 +122,14 @@ impl TryFrom<u16> for Resolution {
 
 /// Converts the contents of a source SDF file to binary and write to
 /// DST.
-fn sdf_to_bsdf<S, D>(res: Resolution, src: S, mut dst: D) -> Result<()>
+fn sdf_to_bsdf<S, D>(
+    res: Resolution,
+    version: BsdfVersion,
+    chunk: u16,
+    codec: ChunkCodec,
+    src: S,
+    mut dst: D,
+) -> Result<()>
 where
     S: BufRead,
     D: Write,
@@ -120,14 +155,32 @@ where
     }
     assert_eq!(line_num, vec.len());
 
-    for elev in vec {
-        dst.write_i16::<LE>(elev)?;
+    match version {
+        BsdfVersion::V0 => {
+            for elev in vec {
+                dst.write_i16::<LE>(elev)?;
+            }
+        }
+        BsdfVersion::V1 => {
+            let (data, offsets) =
+                codec::encode_tile(&vec, res.ippd(), chunk as usize, codec as u16);
+            dst.write_all(&data)?;
+            // Keep the offset table 4-byte aligned.
+            for _ in 0..(4 - data.len() % 4) % 4 {
+                dst.write_u8(0)?;
+            }
+            for offset in offsets {
+                dst.write_u32::<LE>(offset)?;
+            }
+            dst.write_u16::<LE>(chunk)?;
+            dst.write_u16::<LE>(codec as u16)?;
+        }
     }
 
     dst.write_u16::<LE>(res.ippd() as u16)?;
     dst.write_i16::<LE>(min)?;
     dst.write_i16::<LE>(max)?;
-    dst.write_u16::<LE>(BsdfVersion::V0 as u16)?;
+    dst.write_u16::<LE>(version as u16)?;
     dst.flush()?;
     Ok(())
 }
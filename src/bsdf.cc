@@ -0,0 +1,439 @@
+/*
+ * BSDF v1 support.  A v1 tile stores its IPPD x IPPD samples as
+ * independent square chunks.  Compressed, only the parts of a tile a
+ * request actually samples are ever decompressed; uncompressed, the
+ * tile is simply laid out in cache-friendly blocks.
+ *
+ * ┌─────────────────────────────────────┐
+ * │          chunk 0 bit stream         │
+ * ├─────────────────────────────────────┤
+ * │                 ...                 │
+ * ├─────────────────────────────────────┤
+ * │        chunk N - 1 bit stream       │
+ * ├─────────────────────────────────────┤
+ * │     zero padding to 4-byte align    │
+ * ├─────────────────────────────────────┤
+ * │     N + 1 u32 chunk file offsets    │
+ * ├─────────────────────────────────────┤
+ * │           u16 chunk edge            │
+ * ├─────────────────────────────────────┤
+ * │              u16 codec              │
+ * ├─────────────────────────────────────┤
+ * │              u16 IPPD               │
+ * ├─────────────────────────────────────┤
+ * │        i16 minimum elevation        │
+ * ├─────────────────────────────────────┤
+ * │        i16 maximum elevation        │
+ * ├─────────────────────────────────────┤
+ * │            u16 Version (1)          │
+ * └─────────────────────────────────────┘
+ *
+ * Everything is little-endian.  Chunks are stored row by row and
+ * chunk i occupies [offset[i], offset[i + 1]).  Chunks along the
+ * last row and column of a tile are cut short when the chunk edge
+ * does not divide IPPD.
+ *
+ * Codec 0 stores each chunk's samples as they are, row by row, as
+ * i16.  This is a v0 tile in blocked order: a radial in any direction
+ * stays within one block for dozens of samples, where in row-major
+ * order a radial running along the columns touches a new cache line,
+ * and soon a new page, on every step.
+ *
+ * Codec 1 predicts every sample from its west, north and north-west
+ * neighbours with the LOCO-I median edge detector, zigzags the
+ * residual and Rice codes it MSB first.  A chunk starts with one byte
+ * holding its Rice parameter k.  A quotient of BSDF_RICE_ESCAPE or
+ * more is written as that many 1 bits followed by the zigzagged
+ * residual in BSDF_RICE_RAW_BITS bits.
+ *
+ * In either codec, a chunk whose samples all have the same value may
+ * instead be stored as just that value, in BSDF_UNIFORM_CHUNK bytes.
+ * No chunk of real samples is that small, so its size alone marks it.
+ * Such chunks, e.g. over lakes and the sea, are sampled without
+ * reading or decoding anything.
+ */
+#include "bsdf.hh"
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#define BSDF_CHUNKED_FOOTER 12
+
+namespace {
+std::atomic<unsigned long> G_serial{1};
+
+uint16_t get_u16(const unsigned char * p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t get_u32(const unsigned char * p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+/* Reads bits MSB first.  Reading past the end yields zeros, so a
+   corrupt chunk decodes to garbage rather than faulting. */
+class bit_reader {
+    const unsigned char * p;
+    const unsigned char * end;
+    uint64_t acc;
+    int count;
+
+    void refill() {
+        while (count <= 56) {
+            acc |= (uint64_t)(p < end ? *p++ : 0) << (56 - count);
+            count += 8;
+        }
+    }
+
+  public:
+    bit_reader(const unsigned char * p, const unsigned char * end)
+        : p(p)
+        , end(end)
+        , acc(0)
+        , count(0) {}
+
+    uint32_t bits(int n) {
+        if (n == 0) {
+            return 0;
+        }
+
+        if (count < n) {
+            refill();
+        }
+
+        uint32_t v = (uint32_t)(acc >> (64 - n));
+        acc <<= n;
+        count -= n;
+        return v;
+    }
+};
+
+int predict(int x, int y, int w, short const * out) {
+    if (y == 0) {
+        return x == 0 ? 0 : out[x - 1];
+    }
+
+    if (x == 0) {
+        return out[(y - 1) * w];
+    }
+
+    int a = out[(y * w) + x - 1];
+    int b = out[((y - 1) * w) + x];
+    int c = out[((y - 1) * w) + x - 1];
+
+    if (c >= std::max(a, b)) {
+        return std::min(a, b);
+    }
+
+    if (c <= std::min(a, b)) {
+        return std::max(a, b);
+    }
+
+    return a + b - c;
+}
+
+void decode_chunk(const unsigned char * p,
+                  const unsigned char * end,
+                  int w,
+                  int h,
+                  short * out) {
+    int k = p < end ? *p++ & 0x1f : 0;
+    bit_reader in(p, end);
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint32_t q = 0, u;
+
+            while (q < BSDF_RICE_ESCAPE && in.bits(1)) {
+                q++;
+            }
+
+            if (q < BSDF_RICE_ESCAPE) {
+                u = (q << k) | in.bits(k);
+            } else {
+                u = in.bits(BSDF_RICE_RAW_BITS);
+            }
+
+            int e = (int)(u >> 1) ^ -(int)(u & 1);
+            out[(y * w) + x] = (short)(predict(x, y, w, out) + e);
+        }
+    }
+}
+
+/* Returns the value of chunk index if it is uniform, or else
+   BSDF_NOT_UNIFORM. */
+inline int uniform_fill(struct dem_chunks const & chunks, int index) {
+    return chunks.fill.empty() ? BSDF_NOT_UNIFORM : chunks.fill[index];
+}
+
+struct chunk_slot {
+    unsigned long serial;
+    int index;
+    int width;
+    int capacity;
+    short * samples;
+};
+
+/* Frees this thread's decoded chunks when it exits. */
+struct chunk_cache {
+    chunk_slot * slots = nullptr;
+
+    ~chunk_cache() {
+        if (slots) {
+            for (int i = 0; i < BSDF_CHUNK_SLOTS; i++) {
+                delete[] slots[i].samples;
+            }
+            delete[] slots;
+        }
+    }
+};
+
+/* Kept trivially constructible so that the sample path needs no
+   thread_local initialisation checks. */
+thread_local chunk_slot * G_slots = nullptr;
+thread_local chunk_slot * G_last = nullptr;
+
+chunk_slot * chunk_slots() {
+    thread_local chunk_cache cache;
+
+    cache.slots = new chunk_slot[BSDF_CHUNK_SLOTS]();
+    return cache.slots;
+}
+} // namespace
+
+dem_chunks::~dem_chunks() {
+    munmap((void *)map, map_size);
+}
+
+/*
+ * bsdf_version
+ * Returns the version in the footer of the BSDF file open on fd, or
+ * a negative errno.
+ */
+int bsdf_version(int fd) {
+    unsigned char raw[2];
+
+    if (lseek(fd, -2, SEEK_END) == -1) {
+        return -errno;
+    }
+
+    if (read(fd, raw, sizeof(raw)) != sizeof(raw)) {
+        return -EIO;
+    }
+
+    return get_u16(raw);
+}
+
+/*
+ * bsdf_map_chunked
+ * Maps the BSDF v1 file open on fd with the given mmap() flags and
+ * fills in the sample storage, resolution and elevation range of dem.
+ * Returns 0 or a negative errno.
+ */
+int bsdf_map_chunked(int fd, int map_flags, struct dem * dem) {
+    struct stat st;
+
+    if (fstat(fd, &st) == -1) {
+        return -errno;
+    }
+
+    if (st.st_size < BSDF_CHUNKED_FOOTER) {
+        return -EINVAL;
+    }
+
+    void * map = mmap(NULL, st.st_size, PROT_READ, map_flags, fd, 0);
+
+    if (map == MAP_FAILED) {
+        return -errno;
+    }
+
+    auto chunks = std::make_shared<struct dem_chunks>();
+    chunks->map = (const unsigned char *)map;
+    chunks->map_size = st.st_size;
+
+    const unsigned char * footer =
+        chunks->map + chunks->map_size - BSDF_CHUNKED_FOOTER;
+    int dim = get_u16(footer);
+    int codec = get_u16(footer + 2);
+    int ippd = get_u16(footer + 4);
+
+    if (get_u16(footer + 10) != BSDF_VERSION_CHUNKED
+        || (codec != BSDF_CODEC_RAW && codec != BSDF_CODEC_MED_RICE)
+        || (ippd != 1200 && ippd != 3600)
+        || dim < BSDF_MIN_CHUNK_DIM || dim > BSDF_MAX_CHUNK_DIM
+        || (dim & (dim - 1)) != 0) {
+        return -EINVAL;
+    }
+
+    chunks->codec = codec;
+    chunks->ippd = ippd;
+    chunks->dim = dim;
+    chunks->shift = __builtin_ctz(dim);
+    chunks->per_row = (ippd + dim - 1) / dim;
+
+    size_t count = (size_t)chunks->per_row * chunks->per_row;
+    size_t table = sizeof(uint32_t) * (count + 1);
+
+    if (chunks->map_size - BSDF_CHUNKED_FOOTER < table) {
+        return -EINVAL;
+    }
+
+    chunks->offsets = footer - table;
+
+    /* Reject offsets that would send the decoder outside the
+       chunk data once, here, rather than on every decode.  Raw
+       chunks must also be exactly as big as their samples and
+       aligned for reading them in place. */
+
+    size_t limit = chunks->offsets - chunks->map, last = 0;
+
+    for (size_t i = 0; i <= count; i++) {
+        size_t offset = get_u32(chunks->offsets + (sizeof(uint32_t) * i));
+
+        if (offset < last || offset > limit) {
+            return -EINVAL;
+        }
+
+        if (i > 0 && offset - last == BSDF_UNIFORM_CHUNK) {
+            if (chunks->fill.empty()) {
+                chunks->fill.assign(count, BSDF_NOT_UNIFORM);
+            }
+            chunks->fill[i - 1] = (short)get_u16(chunks->map + last);
+        } else if (codec == BSDF_CODEC_RAW && i > 0) {
+            int cx = (int)(i - 1) % chunks->per_row;
+            int cy = (int)(i - 1) / chunks->per_row;
+            size_t size = sizeof(int16_t) * std::min(dim, ippd - (cx * dim))
+                        * std::min(dim, ippd - (cy * dim));
+
+            if (offset - last != size || last % sizeof(int16_t) != 0) {
+                return -EINVAL;
+            }
+        }
+
+        last = offset;
+    }
+
+    chunks->serial = G_serial.fetch_add(1, std::memory_order_relaxed);
+
+    dem->ippd = ippd;
+    dem->min_el = (short)get_u16(footer + 6);
+    dem->max_el = (short)get_u16(footer + 8);
+    dem->data = nullptr;
+    dem->chunks = std::move(chunks);
+
+    return 0;
+}
+
+/*
+ * bsdf_chunk_sample
+ * Returns sample (x, y) of a v1 tile, decoding its chunk into this
+ * thread's chunk cache first if it isn't there already.  Raw chunks
+ * are read in place, and uniform ones not at all.
+ */
+short bsdf_chunk_sample(struct dem_chunks const & chunks, int x, int y) {
+    int cx = x >> chunks.shift, cy = y >> chunks.shift;
+    int index = (cy * chunks.per_row) + cx;
+    int mask = chunks.dim - 1;
+    chunk_slot * slot = G_last;
+
+    int fill = uniform_fill(chunks, index);
+
+    if (fill != BSDF_NOT_UNIFORM) {
+        return (short)fill;
+    }
+
+    if (chunks.codec == BSDF_CODEC_RAW) {
+        int w = std::min(chunks.dim, chunks.ippd - (cx * chunks.dim));
+        const unsigned char * entry =
+            chunks.offsets + (sizeof(uint32_t) * index);
+        const short * block = (const short *)(chunks.map + get_u32(entry));
+
+        return block[((y & mask) * w) + (x & mask)];
+    }
+
+    if (!slot || slot->serial != chunks.serial || slot->index != index) {
+        if (!G_slots) {
+            G_slots = chunk_slots();
+        }
+
+        slot = &G_slots[(index + (chunks.serial * 17)) % BSDF_CHUNK_SLOTS];
+
+        if (slot->serial != chunks.serial || slot->index != index) {
+            int w = std::min(chunks.dim, chunks.ippd - (cx * chunks.dim));
+            int h = std::min(chunks.dim, chunks.ippd - (cy * chunks.dim));
+            const unsigned char * entry =
+                chunks.offsets + (sizeof(uint32_t) * index);
+
+            if (slot->capacity < chunks.dim * chunks.dim) {
+                delete[] slot->samples;
+                slot->capacity = chunks.dim * chunks.dim;
+                slot->samples = new short[slot->capacity];
+            }
+
+            decode_chunk(chunks.map + get_u32(entry),
+                         chunks.map + get_u32(entry + sizeof(uint32_t)),
+                         w,
+                         h,
+                         slot->samples);
+            slot->serial = chunks.serial;
+            slot->index = index;
+            slot->width = w;
+        }
+
+        G_last = slot;
+    }
+
+    return slot->samples[((y & mask) * slot->width) + (x & mask)];
+}
+
+/*
+ * bsdf_decode_tile
+ * Decodes every chunk of a v1 tile into samples, which must hold
+ * IPPD x IPPD samples and is filled in the row-major order of a v0
+ * tile, i.e. sample (x, y) goes to samples[DEM_INDEX(ippd, x, y)].
+ */
+void bsdf_decode_tile(struct dem_chunks const & chunks, short * samples) {
+    std::unique_ptr<short[]> block(new short[chunks.dim * chunks.dim]);
+
+    for (int cy = 0; cy < chunks.per_row; cy++) {
+        for (int cx = 0; cx < chunks.per_row; cx++) {
+            int index = (cy * chunks.per_row) + cx;
+            int w = std::min(chunks.dim, chunks.ippd - (cx * chunks.dim));
+            int h = std::min(chunks.dim, chunks.ippd - (cy * chunks.dim));
+            const unsigned char * entry =
+                chunks.offsets + (sizeof(uint32_t) * index);
+            const unsigned char * p = chunks.map + get_u32(entry);
+
+            int fill = uniform_fill(chunks, index);
+
+            if (fill != BSDF_NOT_UNIFORM) {
+                std::fill_n(block.get(), w * h, (short)fill);
+            } else if (chunks.codec == BSDF_CODEC_RAW) {
+                std::copy_n((const short *)p, w * h, block.get());
+            } else {
+                decode_chunk(p,
+                             chunks.map + get_u32(entry + sizeof(uint32_t)),
+                             w,
+                             h,
+                             block.get());
+            }
+
+            for (int y = 0; y < h; y++) {
+                std::copy_n(block.get() + (y * w),
+                            w,
+                            samples
+                                + DEM_INDEX(chunks.ippd,
+                                            cx * chunks.dim,
+                                            (cy * chunks.dim) + y));
+            }
+        }
+    }
+}
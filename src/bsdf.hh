@@ -0,0 +1,58 @@
+#ifndef _BSDF_HH_
+#define _BSDF_HH_
+
+#include <limits.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "common.hh"
+
+/* BSDF footer versions */
+#define BSDF_VERSION_RAW 0
+#define BSDF_VERSION_CHUNKED 1
+
+/* BSDF v1 chunk codecs */
+#define BSDF_CODEC_RAW 0
+#define BSDF_CODEC_MED_RICE 1
+
+/* Rice quotients this long are escaped to a raw residual */
+#define BSDF_RICE_ESCAPE 24
+#define BSDF_RICE_RAW_BITS 17
+
+#define BSDF_MIN_CHUNK_DIM 8
+#define BSDF_MAX_CHUNK_DIM 256
+
+/* Chunks this big, in either codec, hold the one value of a chunk
+   whose samples are all the same */
+#define BSDF_UNIFORM_CHUNK 2
+
+/* The fill of a chunk that is not uniform */
+#define BSDF_NOT_UNIFORM INT_MIN
+
+/* Decoded chunks each thread keeps around */
+#define BSDF_CHUNK_SLOTS 256
+
+/* The mapped body of a BSDF v1 tile.  Holds the file mapping and
+   unmaps it when the tile is released. */
+struct dem_chunks {
+    const unsigned char * map;
+    size_t map_size;
+    const unsigned char * offsets;
+    int codec;
+    int ippd;
+    int dim;
+    int shift;
+    int per_row;
+    unsigned long serial;
+    /* The value of each uniform chunk, BSDF_NOT_UNIFORM for the
+       others, or empty if the tile has no uniform chunks. */
+    std::vector<int> fill;
+    ~dem_chunks();
+};
+
+int bsdf_version(int fd);
+int bsdf_map_chunked(int fd, int map_flags, struct dem * dem);
+void bsdf_decode_tile(struct dem_chunks const & chunks, short * samples);
+
+#endif /* _BSDF_HH_ */
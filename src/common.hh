@@ -1,6 +1,7 @@
 #ifndef _COMMON_HH_
 #define _COMMON_HH_
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
@@ -35,6 +36,10 @@
 
 #define DEM_INDEX(ippd, x, y) (((y)*ippd) + x)
 
+struct dem_chunks;
+struct dem_overview;
+short bsdf_chunk_sample(struct dem_chunks const & chunks, int x, int y);
+
 struct dem {
     int ippd;
     float min_north;
@@ -43,17 +48,54 @@ struct dem {
     float max_west;
     short max_el;
     short min_el;
+    /* Raw samples, or null for compressed and uniform tiles. */
     short * data;
+    /* Compressed samples of a BSDF v1 tile (see bsdf.hh). */
+    std::shared_ptr<const struct dem_chunks> chunks;
+    /* Decimated copies of the samples (see dem-overview.hh). */
+    std::shared_ptr<struct dem_overview> overview;
+
+    /* Returns whether every sample is min_el and none are stored, as
+       for tiles of constant elevation and ocean placeholders. */
+    bool uniform() const {
+        return !data && !chunks;
+    }
+
+    /* Returns the sample at (x, y). */
+    short sample(int x, int y) const {
+        if (data) {
+            return data[DEM_INDEX(ippd, x, y)];
+        }
+
+        return chunks ? bsdf_chunk_sample(*chunks, x, y) : min_el;
+    }
 };
 
-struct dem_output {
-    std::shared_ptr<const struct dem> dem;
-    float min_north;
-    float max_north;
-    float min_west;
-    float max_west;
-    std::vector<unsigned char> mask;
-    std::vector<unsigned char> signal;
+/* The mask and signal of every pixel over the tiles a request has
+   pinned, in rows from north to south of columns from west to east,
+   so that finding a pixel takes one multiply-add. */
+struct coverage {
+    /* North, south and west edges, in whole degrees */
+    int north;
+    int south;
+    int west;
+    int ippd;
+    long rows;
+    long cols;
+    /* The tiles pinned when it was fitted to them, and the tile, if
+       any, under each ippd x ippd block of pixels */
+    size_t pinned;
+    std::vector<std::shared_ptr<const struct dem>> tiles;
+    /* Every thread sweeping a plot writes these, so each pixel is
+       updated atomically. */
+    std::vector<std::atomic<unsigned char>> mask;
+    std::vector<std::atomic<unsigned char>> signal;
+};
+
+/* Page faults taken while loading and sampling terrain */
+struct dem_faults {
+    unsigned long minor;
+    unsigned long major;
 };
 
 struct site {
@@ -75,6 +117,97 @@ struct Path {
     size_t size() const;
     Path() = default;
     Path(site const & src, site const & dst);
+
+    /* Refills the path from src to dst in place.  Its storage is
+       kept, so a path reserved for ARRAYSIZE samples never grows. */
+    void trace(site const & src, site const & dst);
+    void reserve(size_t samples);
+};
+
+/* A max-elevation hierarchy over a path's samples: level k holds the
+   highest elevation in each aligned run of 2^k samples.  Sight line
+   tests use it to pass over whole runs that can't reach the line. */
+struct PathPeaks {
+    /* Only the first levels are in use; the rest keep their storage
+       for longer paths built later. */
+    std::vector<std::vector<double>> level;
+    size_t levels = 0;
+    PathPeaks() = default;
+    explicit PathPeaks(Path const & path);
+
+    void build(Path const & path);
+
+    /* Returns the first sample in [lo, hi) for which blocks() holds, or
+       hi if there is none.  Runs [first, last] of samples for which
+       may_block(first, last, peak) is false are skipped untested, so
+       it must only be false when blocks() is false throughout. */
+    template <typename Bound, typename Test>
+    ssize_t find(ssize_t lo, ssize_t hi, Bound may_block, Test blocks) const {
+        ssize_t x = lo;
+
+        while (x < hi) {
+            size_t k = 0;
+
+            while (k + 1 < levels && (x & ((2 << k) - 1)) == 0
+                   && x + (2 << k) <= hi) {
+                k++;
+            }
+
+            for (;;) {
+                ssize_t last = x + (1 << k) - 1;
+
+                if (!may_block(x, last, level[k][x >> k])) {
+                    x = last + 1;
+                    break;
+                }
+
+                if (k == 0) {
+                    if (blocks(x)) {
+                        return x;
+                    }
+                    x++;
+                    break;
+                }
+
+                k--;
+            }
+        }
+
+        return hi;
+    }
+};
+
+/* What a transmitter at the start of a path sees of the points along
+   it, taken going out.  Each point is seen at its own elevation angle
+   unless a sample between them rises to meet that sight line, and
+   then at the angle of the first that does.  The first sample to rise
+   to any angle rises above every one before it, so only those are
+   kept, nearest first, and the angles they rise to only grow; each
+   point is a binary search over them, and each sample is added once
+   however many points lie beyond it. */
+struct PathSight {
+    /* Feet from the centre of the earth's curvature to the
+       transmitter, to sea level and, on top of terrain, to clutter */
+    double xmtr_alt;
+    double earth;
+    double clutter;
+    /* Samples from the third on that have been added */
+    ssize_t seen;
+    /* The cosines of the elevation angles of the samples that rose
+       above all those before them */
+    std::vector<double> rise_cos;
+
+    void start(double xmtr_alt, double earth, double clutter);
+    void reserve(size_t samples);
+
+    /* Returns the elevation angle, in degrees, at which point y of
+       path, dest_alt feet from the centre, is seen, and sets block if
+       it is the angle of an obstruction.  Points must be taken in
+       order, and samples nearer than a point taken must not change. */
+    double elevation(Path const & path,
+                     ssize_t y,
+                     double dest_alt,
+                     bool & block);
 };
 
 struct TerrainProfile {
@@ -126,13 +259,28 @@ struct LR {
     int radio_climate;
     int pol;
     antenna_pattern ant_pat;
+    /* Whether LoadPAT() found .az and .el files for ant_pat */
+    unsigned char got_azimuth_pattern;
+    unsigned char got_elevation_pattern;
     double antenna_downtilt;
     double antenna_dt_direction;
     double antenna_rotation;
+    /* Distance beyond which profiles use terrain overviews; 0 = off */
+    double overview_range;
+    bool overview_check;
+    /* Bins of azimuth whose radials share one path; 0 = off, -1 =
+       enough to be half a pixel apart at max_range */
+    int azimuth_bins;
+    /* Whether ITM and ITWOM take their profiles in float */
+    bool compact_profile;
 };
 
 struct output {
-    std::vector<dem_output> dem_out;
+    struct coverage coverage = {};
+    /* Tiles loaded for this request; holding them here keeps the
+       tile cache from evicting them until the request is done. */
+    std::vector<std::shared_ptr<const struct dem>> dem_pin;
+    struct dem_faults dem_faults = {};
     int width;
     int height;
     int min_elevation;
@@ -189,12 +337,7 @@ extern char G_string[];
 extern char G_sdf_path[];
 extern char G_gpsav;
 
-extern unsigned char G_got_elevation_pattern;
-extern unsigned char G_got_azimuth_pattern;
-
-extern std::vector<std::shared_ptr<const struct dem>> G_dem;
-extern std::shared_mutex G_dem_mtx;
-extern struct region G_region;
+extern thread_local struct region G_region;
 
 extern int G_debug;
 
@@ -0,0 +1,106 @@
+/*
+ * The coverage raster of a request.  Plots used to keep a mask and
+ * signal array per tile and find the one holding a location by
+ * trying every tile in turn, once for each pixel the sweep analysed
+ * or the renderers drew.  Instead, one raster spans all the tiles a
+ * request has pinned, so any pixel is found by rounding its latitude
+ * and longitude to a row and a column.
+ *
+ * Tiles are only pinned while terrain is loaded, before the sweep,
+ * so the raster is fitted to them then and whenever more are pinned
+ * later, keeping whatever it already holds.
+ */
+#include "coverage.hh"
+
+#include <limits.h>
+
+#include <algorithm>
+#include <utility>
+
+/*
+ * coverage_fit
+ * Fits out's coverage raster to every tile out has pinned, unless it
+ * already is.  Tiles stay pinned until the request is done, so the
+ * raster only ever grows; the pixels it held are kept and new ones
+ * are clear.  Not to be called while threads are sweeping out.
+ */
+void coverage_fit(struct output * out) {
+    struct coverage & cov = out->coverage;
+
+    if (cov.pinned == out->dem_pin.size()) {
+        return;
+    }
+
+    /* Longitudes are measured from the first tile, so that plots
+       across the prime meridian come out whole. */
+    int ref = (int)out->dem_pin[0]->max_west;
+    int north = INT_MIN, south = INT_MAX, west = INT_MIN, east = INT_MAX;
+    int ippd = out->dem_pin[0]->ippd;
+
+    for (auto const & dem : out->dem_pin) {
+        north = std::max(north, (int)dem->max_north);
+        south = std::min(south, (int)dem->min_north);
+        west = std::max(west, (int)LonDiff(dem->max_west, ref));
+        east = std::min(east, (int)LonDiff(dem->min_west, ref));
+    }
+
+    struct coverage fit;
+    fit.north = north;
+    fit.south = south;
+    fit.west = (ref + west + 360) % 360;
+    fit.ippd = ippd;
+    fit.rows = (long)ippd * (north - south);
+    fit.cols = (long)ippd * (west - east);
+    fit.pinned = out->dem_pin.size();
+    fit.tiles.resize((north - south) * (west - east));
+    fit.mask = std::vector<std::atomic<unsigned char>>(fit.rows * fit.cols);
+    fit.signal = std::vector<std::atomic<unsigned char>>(fit.rows * fit.cols);
+
+    for (auto const & dem : out->dem_pin) {
+        int row = north - (int)dem->max_north;
+        int col = (int)LonDiff(fit.west, dem->max_west);
+
+        fit.tiles[row * (west - east) + col] = dem;
+    }
+
+    if (cov.pinned > 0) {
+        long top = (long)ippd * (north - cov.north);
+        long left = (long)ippd * (long)LonDiff(fit.west, cov.west);
+
+        for (long row = 0; row < cov.rows; row++) {
+            for (long col = 0; col < cov.cols; col++) {
+                long from = row * cov.cols + col;
+                long to = (top + row) * fit.cols + left + col;
+
+                fit.mask[to].store(cov.mask[from].load());
+                fit.signal[to].store(cov.signal[from].load());
+            }
+        }
+    }
+
+    cov = std::move(fit);
+}
+
+/*
+ * coverage_cols
+ * Returns the column of cov under each of width pixels going east
+ * from west, in degrees west, a pixel apart, or -1 for those that
+ * are off it, so that an image of cov can be drawn a row at a time.
+ */
+std::vector<long> coverage_cols(struct coverage const & cov,
+                                double west,
+                                int width) {
+    std::vector<long> cols(width);
+
+    for (int x = 0; x < width; x++) {
+        double lon = west - (G_dpp * (double)x);
+
+        if (lon < 0.0) {
+            lon += 360.0;
+        }
+
+        cols[x] = coverage_col(cov, lon);
+    }
+
+    return cols;
+}
@@ -0,0 +1,55 @@
+#ifndef _COVERAGE_HH_
+#define _COVERAGE_HH_
+
+#include <math.h>
+
+#include <vector>
+
+#include "common.hh"
+#include "signal-server.hh"
+
+void coverage_fit(struct output * out);
+std::vector<long> coverage_cols(struct coverage const & cov,
+                                double west,
+                                int width);
+
+/* Returns the row of cov that lat falls in, or -1 if none does. */
+inline long coverage_row(struct coverage const & cov, double lat) {
+    long x = (long)rint(G_ppd * (lat - cov.south));
+
+    return x >= 0 && x < cov.rows ? cov.rows - 1 - x : -1;
+}
+
+/* Returns the column of cov that lon, in degrees west, falls in, or
+   -1 if none does. */
+inline long coverage_col(struct coverage const & cov, double lon) {
+    long y = (long)rint(G_yppd * LonDiff(cov.west, lon));
+
+    return y >= 0 && y < cov.cols ? y : -1;
+}
+
+/* Returns the pixel of cov at (lat, lon), or -1 outside it. */
+inline long coverage_pixel(struct coverage const & cov,
+                           double lat,
+                           double lon) {
+    long row = coverage_row(cov, lat), col = coverage_col(cov, lon);
+
+    return row >= 0 && col >= 0 ? row * cov.cols + col : -1;
+}
+
+/* Returns the tile under the pixel at row and col of cov, or NULL if
+   there is none, and sets x and y to the pixel's sample in it. */
+inline const struct dem * coverage_tile(struct coverage const & cov,
+                                        long row,
+                                        long col,
+                                        int & x,
+                                        int & y) {
+    long tiles_across = cov.cols / cov.ippd;
+
+    x = cov.ippd - 1 - (int)(row % cov.ippd);
+    y = cov.ippd - 1 - (int)(col % cov.ippd);
+
+    return cov.tiles[(row / cov.ippd) * tiles_across + col / cov.ippd].get();
+}
+
+#endif /* _COVERAGE_HH_ */
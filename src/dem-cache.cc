@@ -0,0 +1,845 @@
+/*
+ * Resident DEM tile registry. Tiles are direct-indexed by the
+ * integer degree cell named in their filename, so finding the tile
+ * under a coordinate is a constant-time slot lookup instead of a
+ * scan over every tile loaded so far.
+ *
+ * Readers don't lock while the registry is unchanged.  It is
+ * published as an immutable snapshot (a table of rows of tiles), and
+ * each thread keeps a copy of the one it last read.  Every publication
+ * bumps a version number, so a reader only checks that against its
+ * copy's; just after a change, it takes the mutex once to copy the new
+ * snapshot.  Snapshots may be kept for as long as callers like, e.g.
+ * for a whole radial.  Writers serialise on the mutex, copy only the
+ * rows they change, and publish the new snapshot under it; old
+ * snapshots, and the tiles only they still reference, go away when
+ * their last reader lets go.  A thread's copy counts as a reader until
+ * the thread next looks at the registry or exits.
+ *
+ * The registry can be given a residency budget in tiles and/or bytes.
+ * Once over budget, tiles are evicted in CLOCK order: every loader
+ * lookup sets the cell's reference bit, and the hand clears set bits
+ * and evicts the first tile it finds unreferenced.  Tiles still held
+ * by a request or an older snapshot, including a thread's stale copy,
+ * are never evicted, so the budget is a soft limit on what the
+ * registry itself keeps alive.
+ *
+ * Cells can also be marked hot, e.g. those around fixed sites that
+ * most requests start from.  Hot tiles are locked into memory, when
+ * they are loaded or when their cell is marked, and are never
+ * evicted.
+ */
+#include "dem-cache.hh"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "bsdf.hh"
+#include "signal-server.hh"
+
+struct dem_row {
+    std::shared_ptr<const struct dem> tile[DEM_CELL_COLS];
+};
+
+struct dem_snapshot {
+    std::shared_ptr<const struct dem_row> row[DEM_CELL_ROWS];
+};
+
+namespace {
+/* The published snapshot, only read or replaced with G_dem_mtx held,
+   and how many snapshots have been published */
+std::mutex G_dem_mtx;
+std::shared_ptr<const struct dem_snapshot> G_dem_snap =
+    std::make_shared<const struct dem_snapshot>();
+std::atomic<unsigned long> G_dem_version{1};
+
+/* This thread's copy of the snapshot, as of version */
+struct snapshot_copy {
+    unsigned long version = 0;
+    std::shared_ptr<const struct dem_snapshot> snap;
+};
+
+thread_local snapshot_copy G_dem_copy;
+std::vector<std::atomic<bool>> G_dem_ref(DEM_CELL_COUNT);
+std::vector<int> G_dem_ring;
+size_t G_dem_hand = 0;
+size_t G_dem_bytes = 0;
+size_t G_max_tiles = 0;
+size_t G_max_bytes = 0;
+std::atomic<int> G_policy{0};
+std::vector<std::atomic<bool>> G_dem_hot(DEM_CELL_COUNT);
+
+std::atomic<unsigned long> G_hits{0};
+std::atomic<unsigned long> G_misses{0};
+std::atomic<unsigned long> G_evictions{0};
+
+std::shared_ptr<const struct dem> const &
+tile_at(struct dem_snapshot const & snap, int cell) {
+    static const std::shared_ptr<const struct dem> none;
+    auto const & row = snap.row[cell / DEM_CELL_COLS];
+
+    return row ? row->tile[cell % DEM_CELL_COLS] : none;
+}
+
+bool sample_index(struct dem const & dem,
+                  double lat,
+                  double lon,
+                  int & x,
+                  int & y) {
+    x = (int)rint(G_ppd * (lat - dem.min_north));
+    y = G_mpi - (int)rint(G_yppd * (LonDiff(dem.max_west, lon)));
+
+    return x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi;
+}
+
+/* A tile owns the samples up to half a pixel beyond its south and
+   east edges (see the rint() in sample_index()), so the first guess
+   is biased by half a pixel and the neighbouring cells are only
+   consulted when it misses. */
+int locate_cell(struct dem_snapshot const & snap,
+                double lat,
+                double lon,
+                int & x,
+                int & y) {
+    static const int offsets[] = {0, -1, 1};
+    int row = (int)floor(lat + (0.5 * G_dpp));
+    int col = (int)ceil(lon - (0.5 * G_dpp)) - 1;
+
+    for (int dr : offsets) {
+        for (int dc : offsets) {
+            int cell = dem_cache_cell(row + dr, col + dc);
+
+            if (cell < 0) {
+                continue;
+            }
+
+            auto const & tile = tile_at(snap, cell);
+
+            if (tile && sample_index(*tile, lat, lon, x, y)) {
+                return cell;
+            }
+        }
+    }
+
+    return -1;
+}
+
+/* Runs of samples are indexed a block at a time, in loops with no
+   calls or branches that the compiler can vectorise. */
+#define SAMPLE_BLOCK 64
+
+/* Rounds to the nearest integer, ties to even, as rint() does in the
+   default rounding mode, for |v| < 2^51.  Unlike rint() it can be
+   inlined into vectorised loops without SSE4.1. */
+inline double round_even(double v) {
+    const double magic = 6755399441055744.0; /* 1.5 * 2^52 */
+
+    return (v + magic) - magic;
+}
+
+/* Returns the elevation at the fractional sample position (fx, fy),
+   interpolated between the four samples around it.  Positions in the
+   half pixel beyond the last row or column are clamped to it. */
+double interpolate(struct dem const & dem, double fx, double fy) {
+    fx = fx < 0.0 ? 0.0 : (fx > G_mpi ? G_mpi : fx);
+    fy = fy < 0.0 ? 0.0 : (fy > G_mpi ? G_mpi : fy);
+
+    int x = fx < G_mpi ? (int)fx : G_mpi - 1;
+    int y = fy < G_mpi ? (int)fy : G_mpi - 1;
+    double tx = fx - x, ty = fy - y;
+
+    return ((1.0 - tx) * (1.0 - ty) * dem.sample(x, y))
+         + (tx * (1.0 - ty) * dem.sample(x + 1, y))
+         + ((1.0 - tx) * ty * dem.sample(x, y + 1))
+         + (tx * ty * dem.sample(x + 1, y + 1));
+}
+
+/* Computes the positions of n points in dem, in samples, and the
+   nearest sample to each, with the same arithmetic as sample_index()
+   so that they land on exactly the samples it would pick.  LonDiff()'s
+   branches are replaced by a wrap that agrees with it except at
+   exactly +/-180 degrees, which is nowhere near the tile either way. */
+inline void index_block(struct dem const & dem,
+                        const double * lat,
+                        const double * lon,
+                        size_t n,
+                        double * fx,
+                        double * fy,
+                        int * x,
+                        int * y) {
+    const double min_north = dem.min_north;
+    const double max_west = dem.max_west;
+    const double ppd = G_ppd, yppd = G_yppd;
+    const int mpi = G_mpi;
+
+    for (size_t j = 0; j < n; j++) {
+        double diff = max_west - lon[j];
+
+        diff -= 360.0 * round_even(diff / 360.0);
+        fx[j] = ppd * (lat[j] - min_north);
+        fy[j] = mpi - (yppd * diff);
+        x[j] = (int)round_even(fx[j]);
+        y[j] = mpi - (int)round_even(yppd * diff);
+    }
+}
+
+/* Samples the longest prefix of the count points that lie strictly
+   inside dem and returns its length.  Edge rows and columns are left
+   to locate_cell(), since a neighbouring tile may own them. */
+size_t sample_run(struct dem const & dem,
+                  const double * lat,
+                  const double * lon,
+                  size_t count,
+                  int flags,
+                  double * elevation) {
+    double fx[SAMPLE_BLOCK], fy[SAMPLE_BLOCK];
+    int x[SAMPLE_BLOCK], y[SAMPLE_BLOCK];
+    size_t done = 0;
+
+    while (done < count) {
+        size_t n = count - done < SAMPLE_BLOCK ? count - done : SAMPLE_BLOCK;
+        size_t inside = 0;
+
+        /* Full blocks get a constant trip count, which is what lets
+           the compiler vectorise them at -O2. */
+        if (n == SAMPLE_BLOCK) {
+            index_block(
+                dem, lat + done, lon + done, SAMPLE_BLOCK, fx, fy, x, y);
+        } else {
+            index_block(dem, lat + done, lon + done, n, fx, fy, x, y);
+        }
+
+        while (inside < n && x[inside] > 0 && x[inside] < G_mpi
+               && y[inside] > 0 && y[inside] < G_mpi) {
+            inside++;
+        }
+
+        /* Uniform tiles, e.g. the sea, hold one value throughout */
+        if (dem.uniform()) {
+            for (size_t j = 0; j < inside; j++) {
+                elevation[done + j] = dem.min_el;
+            }
+        } else if (flags & DEM_SAMPLE_BILINEAR) {
+            for (size_t j = 0; j < inside; j++) {
+                elevation[done + j] = interpolate(dem, fx[j], fy[j]);
+            }
+        } else if (dem.data) {
+            for (size_t j = 0; j < inside; j++) {
+                elevation[done + j] =
+                    dem.data[DEM_INDEX(dem.ippd, x[j], y[j])];
+            }
+        } else {
+            for (size_t j = 0; j < inside; j++) {
+                elevation[done + j] = dem.sample(x[j], y[j]);
+            }
+        }
+
+        done += inside;
+
+        if (inside < n) {
+            break;
+        }
+    }
+
+    return done;
+}
+
+/* Finds the degree cell each of n points falls in, and the index of
+   the nearest sample to it in that cell's tile, with the same
+   arithmetic as sample_index() relative to the tile's own corner.
+   A tile owns the half pixel beyond its south and east edges, so a
+   point that rounds onto the row or column past the north or west
+   edge is handed to the neighbour there, at index 0 or G_mpi.  That
+   also covers points on a whole degree, whose corner round_even()
+   may put a degree too far south or east.  From here on the walk
+   along a path needs no floating point at all. */
+inline void cell_block(const double * lat,
+                       const double * lon,
+                       size_t n,
+                       int * row,
+                       int * col,
+                       int * x,
+                       int * y) {
+    const double ppd = G_ppd, yppd = G_yppd;
+    const int ippd = G_ippd, mpi = G_mpi;
+
+    for (size_t j = 0; j < n; j++) {
+        double north = round_even(lat[j] - 0.5);
+        double west = round_even(lon[j] + 0.5);
+        int dx = (int)round_even(ppd * (lat[j] - north));
+        int dy = (int)round_even(yppd * (west - lon[j]));
+        int past_x = dx > mpi, past_y = dy > mpi;
+
+        row[j] = (int)north + past_x;
+        col[j] = (int)west - 1 - past_y;
+        x[j] = dx - (past_x * ippd);
+        y[j] = mpi - dy + (past_y * ippd);
+    }
+}
+
+/* Samples n consecutive points that cell_block() put in the same
+   cell, at the indices it found.  Cells without a tile of the usual
+   layout, or none at all, are left to locate_cell() point by point,
+   so the result is always what dem_snapshot_locate() would give. */
+void sample_cell(struct dem_snapshot const & snap,
+                 int row,
+                 int col,
+                 const int * x,
+                 const int * y,
+                 size_t n,
+                 const double * lat,
+                 const double * lon,
+                 double * elevation) {
+    int cell = dem_cache_cell(row, col);
+
+    if (cell < 0) {
+        for (size_t j = 0; j < n; j++) {
+            elevation[j] = NAN;
+        }
+        return;
+    }
+
+    struct dem const * dem = tile_at(snap, cell).get();
+
+    if (!dem || dem->ippd != G_ippd || dem->min_north != row
+        || ((int)dem->max_west - col - 1) % 360 != 0) {
+        for (size_t j = 0; j < n; j++) {
+            int tx = 0, ty = 0;
+            int found = locate_cell(snap, lat[j], lon[j], tx, ty);
+
+            elevation[j] =
+                found < 0 ? NAN : tile_at(snap, found)->sample(tx, ty);
+        }
+        return;
+    }
+
+    if (dem->uniform()) {
+        for (size_t j = 0; j < n; j++) {
+            elevation[j] = dem->min_el;
+        }
+    } else if (dem->data) {
+        const short * data = dem->data;
+        const int ippd = dem->ippd;
+
+        for (size_t j = 0; j < n; j++) {
+            elevation[j] = data[DEM_INDEX(ippd, x[j], y[j])];
+        }
+    } else {
+        for (size_t j = 0; j < n; j++) {
+            elevation[j] = dem->sample(x[j], y[j]);
+        }
+    }
+}
+
+/* Samples count points along a path the way a DDA walks a grid: the
+   cell and in-tile index of every point are found up front, a change
+   of cell is where the path crosses into the next tile, and between
+   crossings sampling is a gather from one tile's samples.  Only for
+   whole-degree tiles sampled at their own resolution. */
+void walk_path(struct dem_snapshot const & snap,
+               const double * lat,
+               const double * lon,
+               size_t count,
+               double * elevation) {
+    int row[SAMPLE_BLOCK], col[SAMPLE_BLOCK];
+    int x[SAMPLE_BLOCK], y[SAMPLE_BLOCK];
+
+    for (size_t done = 0; done < count;) {
+        size_t n = count - done < SAMPLE_BLOCK ? count - done : SAMPLE_BLOCK;
+
+        if (n == SAMPLE_BLOCK) {
+            cell_block(lat + done, lon + done, SAMPLE_BLOCK, row, col, x, y);
+        } else {
+            cell_block(lat + done, lon + done, n, row, col, x, y);
+        }
+
+        for (size_t j = 0; j < n;) {
+            size_t end = j + 1;
+
+            while (end < n && row[end] == row[j] && col[end] == col[j]) {
+                end++;
+            }
+
+            sample_cell(snap,
+                        row[j],
+                        col[j],
+                        x + j,
+                        y + j,
+                        end - j,
+                        lat + done + j,
+                        lon + done + j,
+                        elevation + done + j);
+            j = end;
+        }
+
+        done += n;
+    }
+}
+
+void touch(int cell) {
+    /* Only store when the bit is clear so that hot tiles don't
+       bounce their cache line between threads. */
+    if (!G_dem_ref[cell].load(std::memory_order_relaxed)) {
+        G_dem_ref[cell].store(true, std::memory_order_relaxed);
+    }
+}
+
+size_t tile_bytes(struct dem const & dem) {
+    void * map;
+    size_t size;
+
+    dem_cache_tile_mapping(dem, &map, &size);
+
+    return size;
+}
+
+/* Locks a hot tile's samples into memory.  Failing only costs
+   performance, so failures are only reported. */
+void lock_tile(struct dem const & dem) {
+    void * map;
+    size_t size;
+
+    dem_cache_tile_mapping(dem, &map, &size);
+
+    if (map && mlock(map, size) == -1 && G_debug) {
+        fprintf(stderr, "Can't lock hot tile: %s\n", strerror(errno));
+    }
+}
+
+bool over_budget() {
+    return (G_max_tiles && G_dem_ring.size() > G_max_tiles)
+        || (G_max_bytes && G_dem_bytes > G_max_bytes);
+}
+
+/* A copy-on-write edit of the published snapshot, made with G_dem_mtx
+   held.  Rows are copied the first time they are written, and the
+   result replaces the published snapshot, and bumps its version, in
+   one go. */
+class snapshot_edit {
+    std::shared_ptr<const struct dem_snapshot> base;
+    std::shared_ptr<struct dem_snapshot> next;
+    std::shared_ptr<struct dem_row> copied[DEM_CELL_ROWS];
+
+  public:
+    snapshot_edit()
+        : base(G_dem_snap)
+        , next(std::make_shared<struct dem_snapshot>(*base)) {}
+
+    std::shared_ptr<const struct dem> const & get(int cell) const {
+        return tile_at(*next, cell);
+    }
+
+    void set(int cell, std::shared_ptr<const struct dem> tile) {
+        int r = cell / DEM_CELL_COLS;
+
+        if (!copied[r]) {
+            copied[r] = base->row[r]
+                          ? std::make_shared<struct dem_row>(*base->row[r])
+                          : std::make_shared<struct dem_row>();
+            next->row[r] = copied[r];
+        }
+
+        copied[r]->tile[cell % DEM_CELL_COLS] = std::move(tile);
+    }
+
+    /* Besides any request or older snapshot using it, a tile is
+       referenced by the edited row and, if the row was copied while
+       the tile was resident, by the base row as well. */
+    bool pinned(int cell) const {
+        auto const & tile = get(cell);
+        long refs = 1;
+
+        if (copied[cell / DEM_CELL_COLS] && tile_at(*base, cell) == tile) {
+            refs++;
+        }
+
+        return tile.use_count() > refs;
+    }
+
+    void publish() {
+        G_dem_snap = std::move(next);
+        G_dem_version.fetch_add(1, std::memory_order_release);
+    }
+};
+
+/* Evicted tiles are moved into victims so that they can be released
+   after G_dem_mtx is dropped. */
+void evict(snapshot_edit & edit,
+           std::vector<std::shared_ptr<const struct dem>> & victims) {
+    /* Two turns of the hand clear every reference bit, so whatever
+       survives them is pinned. */
+    size_t steps = 2 * G_dem_ring.size();
+
+    while (over_budget() && steps-- > 0) {
+        if (G_dem_hand >= G_dem_ring.size()) {
+            G_dem_hand = 0;
+        }
+
+        int cell = G_dem_ring[G_dem_hand];
+
+        if (G_dem_hot[cell].load(std::memory_order_relaxed)
+            || G_dem_ref[cell].exchange(false, std::memory_order_relaxed)
+            || edit.pinned(cell)) {
+            G_dem_hand++;
+            continue;
+        }
+
+        G_dem_bytes -= tile_bytes(*edit.get(cell));
+        victims.push_back(edit.get(cell));
+        edit.set(cell, nullptr);
+        G_dem_ring[G_dem_hand] = G_dem_ring.back();
+        G_dem_ring.pop_back();
+        G_evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+} // namespace
+
+/*
+ * dem_cache_cell
+ * Returns the registry slot for the tile whose south-east corner
+ * is at (min_north, min_west), or -1 if that is not a valid cell.
+ */
+int dem_cache_cell(int min_north, int min_west) {
+    min_west %= DEM_CELL_COLS;
+
+    if (min_west < 0) {
+        min_west += DEM_CELL_COLS;
+    }
+
+    if (min_north < -90 || min_north >= 90) {
+        return -1;
+    }
+
+    return ((min_north + 90) * DEM_CELL_COLS) + min_west;
+}
+
+/*
+ * dem_cache_snapshot
+ * Returns the current set of resident tiles.  Callers doing many
+ * lookups should take one snapshot and use dem_snapshot_locate().
+ * The reference is to this thread's copy, which the thread's next
+ * call may replace; copy it to keep the snapshot for longer.
+ */
+std::shared_ptr<const struct dem_snapshot> const & dem_cache_snapshot() {
+    snapshot_copy & copy = G_dem_copy;
+
+    if (copy.version != G_dem_version.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(G_dem_mtx);
+
+        copy.snap = G_dem_snap;
+        copy.version = G_dem_version.load(std::memory_order_relaxed);
+    }
+
+    return copy.snap;
+}
+
+/*
+ * dem_snapshot_locate
+ * Returns the tile in snap holding the sample nearest to (lat, lon)
+ * and stores that sample's index in x and y.  The tile stays valid
+ * for as long as snap is held.
+ */
+const struct dem * dem_snapshot_locate(struct dem_snapshot const & snap,
+                                       double lat,
+                                       double lon,
+                                       int & x,
+                                       int & y) {
+    int cell = locate_cell(snap, lat, lon, x, y);
+
+    return cell < 0 ? nullptr : tile_at(snap, cell).get();
+}
+
+/*
+ * dem_snapshot_sample
+ * Fills elevation[i] with the height in metres of (lat[i], lon[i])
+ * for count points, or with NAN where snap has no tile.  Points are
+ * sampled at the nearest sample, as dem_snapshot_locate() would pick
+ * it, unless flags has DEM_SAMPLE_BILINEAR.  Consecutive points in
+ * the same tile are looked up once, so points should be ordered,
+ * e.g. along a path.
+ */
+void dem_snapshot_sample(struct dem_snapshot const & snap,
+                         const double * lat,
+                         const double * lon,
+                         size_t count,
+                         int flags,
+                         double * elevation) {
+    size_t i = 0;
+
+    if (!(flags & DEM_SAMPLE_BILINEAR) && G_ppd == G_ippd
+        && G_yppd == G_ippd) {
+        walk_path(snap, lat, lon, count, elevation);
+        return;
+    }
+
+    while (i < count) {
+        int x = 0, y = 0;
+        int cell = locate_cell(snap, lat[i], lon[i], x, y);
+
+        if (cell < 0) {
+            elevation[i++] = NAN;
+            continue;
+        }
+
+        struct dem const & dem = *tile_at(snap, cell);
+
+        if (flags & DEM_SAMPLE_BILINEAR) {
+            elevation[i] = interpolate(
+                dem,
+                G_ppd * (lat[i] - dem.min_north),
+                G_mpi - (G_yppd * LonDiff(dem.max_west, lon[i])));
+        } else {
+            elevation[i] = dem.sample(x, y);
+        }
+
+        i++;
+        i += sample_run(dem, lat + i, lon + i, count - i, flags, elevation + i);
+    }
+}
+
+/*
+ * dem_cache_find
+ * Returns the resident tile named (min_north, min_west), if any.
+ */
+std::shared_ptr<const struct dem> dem_cache_find(int min_north, int min_west) {
+    int cell = dem_cache_cell(min_north, min_west);
+
+    if (cell < 0) {
+        return nullptr;
+    }
+
+    auto const & tile = tile_at(*dem_cache_snapshot(), cell);
+
+    if (tile) {
+        touch(cell);
+        G_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return tile;
+}
+
+/*
+ * dem_cache_locate
+ * Returns the resident tile holding the sample nearest to (lat, lon)
+ * and stores that sample's index in x and y.
+ */
+std::shared_ptr<const struct dem>
+dem_cache_locate(double lat, double lon, int & x, int & y) {
+    auto const & snap = *dem_cache_snapshot();
+    int cell = locate_cell(snap, lat, lon, x, y);
+
+    return cell < 0 ? nullptr : tile_at(snap, cell);
+}
+
+/*
+ * dem_cache_insert
+ * Registers a freshly loaded tile and returns the tile now resident
+ * in its cell.  A tile already resident in the same cell is kept;
+ * the new one is dropped.  May evict other tiles to stay in budget.
+ * The tile is locked into memory if its cell is hot.
+ */
+std::shared_ptr<const struct dem>
+dem_cache_insert(std::shared_ptr<const struct dem> dem) {
+    std::vector<std::shared_ptr<const struct dem>> victims;
+    int cell = dem_cache_cell((int)dem->min_north, (int)dem->min_west);
+    bool hot;
+
+    if (cell < 0) {
+        return dem;
+    }
+
+    std::unique_lock<std::mutex> lock(G_dem_mtx);
+    snapshot_edit edit;
+
+    if (auto const & resident = edit.get(cell)) {
+        touch(cell);
+        return resident;
+    }
+
+    edit.set(cell, dem);
+    G_dem_ref[cell].store(true, std::memory_order_relaxed);
+    G_dem_ring.push_back(cell);
+    G_dem_bytes += tile_bytes(*dem);
+    G_misses.fetch_add(1, std::memory_order_relaxed);
+
+    evict(edit, victims);
+    edit.publish();
+
+    /* Checked with the tile published under the mutex, so either
+       dem_cache_add_hot() finds the tile resident or the tile finds
+       its cell hot.  Locking it can fault it all in, so that is left
+       until the mutex is dropped. */
+    hot = G_dem_hot[cell].load(std::memory_order_relaxed);
+    lock.unlock();
+
+    if (hot) {
+        lock_tile(*dem);
+    }
+
+    return dem;
+}
+
+/*
+ * dem_cache_set_budget
+ * Limits the registry to max_tiles tiles and max_bytes bytes of
+ * elevation samples; zero leaves that dimension unlimited.
+ */
+void dem_cache_set_budget(size_t max_tiles, size_t max_bytes) {
+    std::vector<std::shared_ptr<const struct dem>> victims;
+    std::lock_guard<std::mutex> lock(G_dem_mtx);
+    snapshot_edit edit;
+
+    G_max_tiles = max_tiles;
+    G_max_bytes = max_bytes;
+
+    evict(edit, victims);
+
+    if (!victims.empty()) {
+        edit.publish();
+    }
+}
+
+/*
+ * dem_cache_set_policy
+ * Sets how tiles are mapped from now on: DEM_POLICY_POPULATE faults
+ * every page of a tile in as it is mapped, instead of on first touch
+ * during the sweep, and DEM_POLICY_HUGEPAGE asks the kernel to back
+ * tile mappings with transparent huge pages where it can.
+ */
+void dem_cache_set_policy(int flags) {
+    G_policy.store(flags, std::memory_order_relaxed);
+}
+
+/*
+ * dem_cache_policy
+ * Returns the DEM_POLICY_* flags tiles are mapped with.
+ */
+int dem_cache_policy() {
+    return G_policy.load(std::memory_order_relaxed);
+}
+
+/*
+ * dem_cache_add_hot
+ * Marks the cells within radius_km of (lat, lon), longitude in
+ * degrees west, as hot.  Tiles in hot cells are locked in memory,
+ * those already resident as they are marked, and are exempt from
+ * eviction.
+ */
+void dem_cache_add_hot(double lat, double lon, double radius_km) {
+    /* The same degrees-per-mile rule of thumb handle_args() uses to
+       pick the tiles an analysis needs. */
+    double deg_lat = (radius_km / KM_PER_MILE) / 57.0;
+    double deg_lon = deg_lat / cos(DEG2RAD * (fabs(lat) < 70.0 ? lat : 70.0));
+    std::lock_guard<std::mutex> lock(G_dem_mtx);
+
+    for (int row = (int)floor(lat - deg_lat); row <= (int)floor(lat + deg_lat);
+         row++) {
+        for (int col = (int)floor(lon - deg_lon);
+             col <= (int)floor(lon + deg_lon);
+             col++) {
+            int cell = dem_cache_cell(row, col);
+
+            if (cell < 0
+                || G_dem_hot[cell].exchange(true, std::memory_order_relaxed)) {
+                continue;
+            }
+
+            if (auto const & tile = tile_at(*G_dem_snap, cell)) {
+                lock_tile(*tile);
+            }
+        }
+    }
+}
+
+/*
+ * dem_cache_tile_mapping
+ * Stores the file mapping that backs a tile's samples, or a null one
+ * for uniform tiles, in map and size.
+ */
+void dem_cache_tile_mapping(struct dem const & dem,
+                            void ** map,
+                            size_t * size) {
+    if (dem.data) {
+        *map = dem.data;
+        *size = sizeof(short) * dem.ippd * dem.ippd;
+    } else if (dem.chunks) {
+        *map = (void *)dem.chunks->map;
+        *size = dem.chunks->map_size;
+    } else {
+        *map = NULL;
+        *size = 0;
+    }
+}
+
+/*
+ * dem_cache_is_hot
+ * Returns whether cell has been marked hot.
+ */
+bool dem_cache_is_hot(int cell) {
+    return cell >= 0 && G_dem_hot[cell].load(std::memory_order_relaxed);
+}
+
+/*
+ * dem_cache_thread_faults
+ * Stores the page faults the calling thread has taken so far.  The
+ * difference between two calls around terrain access counts the
+ * faults it took.
+ */
+void dem_cache_thread_faults(struct dem_faults * faults) {
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_THREAD, &usage) == -1) {
+        faults->minor = faults->major = 0;
+        return;
+    }
+
+    faults->minor = usage.ru_minflt;
+    faults->major = usage.ru_majflt;
+}
+
+/*
+ * dem_cache_count_faults
+ * Adds the page faults the calling thread has taken since the
+ * dem_cache_thread_faults() snapshot mark to total.
+ */
+void dem_cache_count_faults(struct dem_faults * total,
+                            struct dem_faults const & mark) {
+    struct dem_faults now;
+
+    dem_cache_thread_faults(&now);
+    total->minor += now.minor - mark.minor;
+    total->major += now.major - mark.major;
+}
+
+/*
+ * dem_cache_get_stats
+ * Fills in the lookup counters and current residency.  Hits count
+ * loader lookups answered from memory, misses count tiles that had
+ * to be loaded.
+ */
+void dem_cache_get_stats(struct dem_cache_stats * stats) {
+    std::lock_guard<std::mutex> lock(G_dem_mtx);
+
+    stats->hits = G_hits.load(std::memory_order_relaxed);
+    stats->misses = G_misses.load(std::memory_order_relaxed);
+    stats->evictions = G_evictions.load(std::memory_order_relaxed);
+    stats->tiles = G_dem_ring.size();
+    stats->bytes = G_dem_bytes;
+}
+
+/*
+ * dem_cache_size
+ * Returns the number of resident tiles.
+ */
+size_t dem_cache_size() {
+    std::lock_guard<std::mutex> lock(G_dem_mtx);
+    return G_dem_ring.size();
+}
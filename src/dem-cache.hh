@@ -0,0 +1,66 @@
+#ifndef _DEM_CACHE_HH_
+#define _DEM_CACHE_HH_
+
+#include <stddef.h>
+
+#include <memory>
+
+#include "common.hh"
+
+/* Tiles are named by the integer degree cell of their south-east
+   corner, so every resident tile maps onto one slot of a fixed
+   180 x 360 grid. */
+#define DEM_CELL_ROWS 180
+#define DEM_CELL_COLS 360
+#define DEM_CELL_COUNT (DEM_CELL_ROWS * DEM_CELL_COLS)
+
+/* Residency policies for dem_cache_set_policy() */
+#define DEM_POLICY_POPULATE 0x1 /* fault tiles in when they are mapped */
+#define DEM_POLICY_HUGEPAGE 0x2 /* ask for transparent huge pages */
+
+/* Flags for dem_snapshot_sample() */
+#define DEM_SAMPLE_BILINEAR 0x1
+
+/* An immutable view of the resident tiles.  Holding one keeps every
+   tile in it mapped, and looking tiles up in it takes no locks. */
+struct dem_snapshot;
+
+struct dem_cache_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    size_t tiles;
+    size_t bytes;
+};
+
+int dem_cache_cell(int min_north, int min_west);
+std::shared_ptr<const struct dem_snapshot> const & dem_cache_snapshot();
+const struct dem * dem_snapshot_locate(struct dem_snapshot const & snap,
+                                       double lat,
+                                       double lon,
+                                       int & x,
+                                       int & y);
+void dem_snapshot_sample(struct dem_snapshot const & snap,
+                         const double * lat,
+                         const double * lon,
+                         size_t count,
+                         int flags,
+                         double * elevation);
+std::shared_ptr<const struct dem> dem_cache_find(int min_north, int min_west);
+std::shared_ptr<const struct dem>
+dem_cache_locate(double lat, double lon, int & x, int & y);
+std::shared_ptr<const struct dem>
+dem_cache_insert(std::shared_ptr<const struct dem> dem);
+void dem_cache_set_budget(size_t max_tiles, size_t max_bytes);
+void dem_cache_set_policy(int flags);
+int dem_cache_policy();
+void dem_cache_add_hot(double lat, double lon, double radius_km);
+bool dem_cache_is_hot(int cell);
+void dem_cache_tile_mapping(struct dem const & dem, void ** map, size_t * size);
+void dem_cache_thread_faults(struct dem_faults * faults);
+void dem_cache_count_faults(struct dem_faults * total,
+                            struct dem_faults const & mark);
+void dem_cache_get_stats(struct dem_cache_stats * stats);
+size_t dem_cache_size();
+
+#endif /* _DEM_CACHE_HH_ */
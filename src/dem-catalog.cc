@@ -0,0 +1,288 @@
+/*
+ * A catalogue of the tiles that exist on disk.  Plots over the sea
+ * or along coasts ask for many tiles that were never made, and each
+ * of them used to cost a failed open() in every directory searched
+ * before LoadSDF() gave up and assumed sea level.  Instead, the tile
+ * directories are listed once and every tile file found, BSDF or
+ * legacy SDF, is marked in a bitmap over the degree cells of each
+ * resolution.  Cells without a mark are known to be water with no
+ * filesystem I/O at all.
+ *
+ * The catalogue is only as fresh as its last scan.  Processes that
+ * see tiles added while they run can have it watch the directories
+ * with inotify and keep itself up to date.  Until a scan has
+ * succeeded, every tile is looked for on disk as before.
+ */
+#include "dem-catalog.hh"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.hh"
+#include "dem-cache.hh"
+#include "sdf.hh"
+
+#define CATALOG_WORDS ((DEM_CELL_COUNT + 63) / 64)
+
+/* Events that can change which tiles exist */
+#define CATALOG_EVENTS                                                     \
+    (IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF \
+     | IN_MOVE_SELF)
+
+namespace {
+/* One bitmap per resolution: 1200 and 3600 IPPD */
+typedef std::vector<uint64_t> bitmap;
+
+std::atomic<uint64_t> G_present[2][CATALOG_WORDS];
+std::atomic<bool> G_scanned(false);
+std::mutex G_scan_mtx;
+bool G_watching = false;
+
+/* Returns the directories tiles are searched for in, without
+   duplicates; "." stands for the working directory. */
+std::vector<std::string> tile_dirs() {
+    std::vector<std::string> dirs = {"."};
+
+    for (const char * dir : {(const char *)G_sdf_path, sdf_cache_path()}) {
+        std::string path(dir);
+
+        while (path.size() > 1 && path.back() == '/') {
+            path.pop_back();
+        }
+
+        if (!path.empty() && std::find(dirs.begin(), dirs.end(), path)
+                                 == dirs.end()) {
+            dirs.push_back(path);
+        }
+    }
+
+    return dirs;
+}
+
+/* Returns the cell of the tile a file called name holds, and sets
+   hd if it is a 3600 IPPD one, or returns -1 if it holds no tile. */
+int tile_cell(const char * name, int * hd) {
+    int minlat, maxlat, minlon, maxlon, used = 0;
+
+    if (sscanf(name, "%d:%d:%d:%d%n", &minlat, &maxlat, &minlon, &maxlon, &used)
+            != 4
+        || used == 0) {
+        return -1;
+    }
+
+    const char * rest = name + used;
+
+    *hd = strncmp(rest, "-hd", 3) == 0;
+    rest += *hd ? 3 : 0;
+
+    if (strcmp(rest, ".bsdf") != 0 && strcmp(rest, ".sdf") != 0
+        && strcmp(rest, ".sdf.gz") != 0 && strcmp(rest, ".sdf.bz2") != 0) {
+        return -1;
+    }
+
+    return dem_cache_cell(minlat, minlon);
+}
+
+/* Lists every tile directory into a fresh catalogue and publishes it. */
+int scan() {
+    bitmap present[2] = {bitmap(CATALOG_WORDS), bitmap(CATALOG_WORDS)};
+    auto started = std::chrono::steady_clock::now();
+    unsigned long entries = 0;
+
+    for (auto const & dir : tile_dirs()) {
+        DIR * d = opendir(dir.c_str());
+
+        /* A missing directory holds no tiles, but one we can't list
+           might; look for tiles on disk rather than guess. */
+        if (!d) {
+            if (errno == ENOENT) {
+                continue;
+            }
+            int err = errno;
+            G_scanned = false;
+            return -err;
+        }
+
+        while (struct dirent * ent = readdir(d)) {
+            int hd, cell = tile_cell(ent->d_name, &hd);
+
+            if (cell >= 0) {
+                present[hd][cell / 64] |= (uint64_t)1 << (cell % 64);
+            }
+            entries++;
+        }
+
+        closedir(d);
+    }
+
+    for (int hd = 0; hd < 2; hd++) {
+        for (int w = 0; w < CATALOG_WORDS; w++) {
+            G_present[hd][w].store(present[hd][w], std::memory_order_relaxed);
+        }
+    }
+
+    G_scanned.store(true, std::memory_order_release);
+
+    if (G_debug == 1) {
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - started;
+        fprintf(stderr,
+                "Catalogued %lu directory entries in %.1f ms\n",
+                entries,
+                elapsed.count());
+        fflush(stderr);
+    }
+
+    return 0;
+}
+
+/* Applies inotify events from fd to the catalogue until it fails. */
+void watch(int fd) {
+    alignas(struct inotify_event) char buf[4096];
+
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            break;
+        }
+
+        bool rescan = false, lost = false;
+
+        for (char * p = buf; p < buf + n;) {
+            auto event = (struct inotify_event *)p;
+
+            /* New tiles can just be marked, but a removed one may
+               still have a file of another format, and lost events
+               leave us guessing.  Once a directory itself goes, tiles
+               put back in its place would go unseen. */
+            int hd = 0, cell = event->len ? tile_cell(event->name, &hd) : -1;
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                lost = true;
+            } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                if (cell >= 0) {
+                    G_present[hd][cell / 64].fetch_or((uint64_t)1
+                                                      << (cell % 64));
+                }
+            } else if (cell >= 0 || (event->mask & IN_Q_OVERFLOW)) {
+                rescan = true;
+            }
+
+            p += sizeof(struct inotify_event) + event->len;
+        }
+
+        if (lost) {
+            break;
+        }
+
+        if (rescan) {
+            std::lock_guard<std::mutex> lock(G_scan_mtx);
+            scan();
+        }
+    }
+
+    /* Without events the catalogue would go stale; fall back to
+       looking for every tile on disk. */
+    std::lock_guard<std::mutex> lock(G_scan_mtx);
+    G_scanned = false;
+    G_watching = false;
+    close(fd);
+
+    if (G_debug == 1) {
+        fprintf(stderr, "Stopped watching tile directories\n");
+        fflush(stderr);
+    }
+}
+} // namespace
+
+/*
+ * dem_catalog_scan
+ * Lists the working directory, G_sdf_path and the directory legacy
+ * tiles are transcoded into, and catalogues the tiles found there.
+ * Returns 0, or a negative errno after which the catalogue is off
+ * and every tile is looked for on disk.
+ */
+int dem_catalog_scan() {
+    std::lock_guard<std::mutex> lock(G_scan_mtx);
+    return scan();
+}
+
+/*
+ * dem_catalog_watch
+ * Keeps the catalogue up to date with tiles added to or removed
+ * from the tile directories from now on.  Returns 0 or a negative
+ * errno.
+ */
+int dem_catalog_watch() {
+    std::lock_guard<std::mutex> lock(G_scan_mtx);
+
+    if (G_watching) {
+        return 0;
+    }
+
+    int fd = inotify_init1(IN_CLOEXEC);
+
+    if (fd == -1) {
+        return -errno;
+    }
+
+    /* Watch before scanning so that no tile can slip in between. */
+    for (auto const & dir : tile_dirs()) {
+        if (inotify_add_watch(fd, dir.c_str(), CATALOG_EVENTS) == -1
+            && errno != ENOENT) {
+            int err = errno;
+            close(fd);
+            return -err;
+        }
+    }
+
+    int err = scan();
+
+    if (err) {
+        close(fd);
+        return err;
+    }
+
+    G_watching = true;
+    std::thread(watch, fd).detach();
+
+    return 0;
+}
+
+/*
+ * dem_catalog_absent
+ * Returns whether the catalogue knows that there is no file for the
+ * tile whose south-east corner is (min_north, min_west) at ippd.
+ * Without a catalogue nothing is known to be absent.
+ */
+bool dem_catalog_absent(int min_north, int min_west, int ippd) {
+    int cell = dem_cache_cell(min_north, min_west);
+
+    if (cell < 0 || !G_scanned.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    uint64_t word =
+        G_present[ippd == 3600][cell / 64].load(std::memory_order_relaxed);
+
+    return !(word & ((uint64_t)1 << (cell % 64)));
+}
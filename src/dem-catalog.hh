@@ -0,0 +1,8 @@
+#ifndef _DEM_CATALOG_HH_
+#define _DEM_CATALOG_HH_
+
+int dem_catalog_scan();
+int dem_catalog_watch();
+bool dem_catalog_absent(int min_north, int min_west, int ippd);
+
+#endif /* _DEM_CATALOG_HH_ */
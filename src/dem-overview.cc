@@ -0,0 +1,113 @@
+/*
+ * Decimated overview levels of DEM tiles.  Far along a long radial,
+ * terrain detail finer than the spacing of the profile handed to the
+ * propagation model only adds aliasing and work, so profiles there
+ * are built from block-averaged copies of the tiles instead.
+ *
+ * Overviews are built in memory from a tile the first time one of
+ * its levels is sampled, and live as long as the tile does.  They
+ * cost a third of the tile's raw size and are not counted against
+ * the tile cache budget.
+ */
+#include "dem-overview.hh"
+
+#include "dem-cache.hh"
+
+namespace {
+/* Each level averages 2 x 2 blocks of the level below it; blocks on
+   the east and south edges of odd-sized levels are averaged over the
+   samples they do have. */
+void build(struct dem const & dem, struct dem_overview & ov) {
+    ov.width[0] = dem.ippd;
+
+    for (int n = 1; n <= DEM_OVERVIEW_LEVELS; n++) {
+        int below = ov.width[n - 1];
+        int width = (below + 1) / 2;
+
+        ov.width[n] = width;
+        ov.level[n].resize((size_t)width * width);
+
+        for (int y = 0; y < width; y++) {
+            for (int x = 0; x < width; x++) {
+                int sum = 0, count = 0;
+
+                for (int by = 2 * y; by < 2 * y + 2 && by < below; by++) {
+                    for (int bx = 2 * x; bx < 2 * x + 2 && bx < below; bx++) {
+                        sum += n == 1
+                                 ? dem.sample(bx, by)
+                                 : ov.level[n - 1][DEM_INDEX(below, bx, by)];
+                        count++;
+                    }
+                }
+
+                ov.level[n][DEM_INDEX(width, x, y)] = (short)(sum / count);
+            }
+        }
+    }
+}
+} // namespace
+
+/*
+ * dem_overview_sample
+ * Returns the overview sample of dem at the given level covering the
+ * full-resolution sample (x, y).  Tiles without overviews, such as
+ * ocean placeholders, are sampled at full resolution.
+ */
+short dem_overview_sample(struct dem const & dem, int level, int x, int y) {
+    if (level <= 0 || !dem.overview) {
+        return dem.sample(x, y);
+    }
+
+    if (level > DEM_OVERVIEW_LEVELS) {
+        level = DEM_OVERVIEW_LEVELS;
+    }
+
+    struct dem_overview & ov = *dem.overview;
+
+    std::call_once(ov.built, build, std::cref(dem), std::ref(ov));
+
+    x >>= level;
+    y >>= level;
+
+    return ov.level[level][DEM_INDEX(ov.width[level], x, y)];
+}
+
+/*
+ * dem_overview_elevation
+ * Returns the elevation in feet of (lat, lon) at the given overview
+ * level, or -5000.0 where no tile is resident, like GetElevation().
+ */
+double dem_overview_elevation(struct dem_snapshot const & snap,
+                              double lat,
+                              double lon,
+                              int level) {
+    int x = 0, y = 0;
+    const struct dem * found = dem_snapshot_locate(snap, lat, lon, x, y);
+
+    if (!found) {
+        return -5000.0;
+    }
+
+    return FEET_PER_METER * dem_overview_sample(*found, level, x, y);
+}
+
+/*
+ * dem_overview_level
+ * Returns the overview level to use at distance from the transmitter:
+ * full resolution out to overview_range, then one level coarser each
+ * time the distance doubles.  A zero overview_range disables them.
+ */
+int dem_overview_level(double distance, double overview_range) {
+    int level = 0;
+
+    if (overview_range <= 0.0) {
+        return 0;
+    }
+
+    while (level < DEM_OVERVIEW_LEVELS
+           && distance > overview_range * (double)(1 << level)) {
+        level++;
+    }
+
+    return level;
+}
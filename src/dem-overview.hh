@@ -0,0 +1,30 @@
+#ifndef _DEM_OVERVIEW_HH_
+#define _DEM_OVERVIEW_HH_
+
+#include <mutex>
+#include <vector>
+
+#include "common.hh"
+
+/* Overview level n averages 2^n x 2^n blocks of full-resolution
+   samples; level 0 is the tile itself. */
+#define DEM_OVERVIEW_LEVELS 3
+
+struct dem_snapshot;
+
+/* Decimated copies of a tile, built from it the first time any of
+   them is sampled. */
+struct dem_overview {
+    std::once_flag built;
+    int width[DEM_OVERVIEW_LEVELS + 1];
+    std::vector<short> level[DEM_OVERVIEW_LEVELS + 1];
+};
+
+short dem_overview_sample(struct dem const & dem, int level, int x, int y);
+double dem_overview_elevation(struct dem_snapshot const & snap,
+                              double lat,
+                              double lon,
+                              int level);
+int dem_overview_level(double distance, double overview_range);
+
+#endif /* _DEM_OVERVIEW_HH_ */
@@ -0,0 +1,370 @@
+/*
+ * A host-wide catalogue of decoded tiles in POSIX shared memory, for
+ * deployments that run several signalserver processes side by side.
+ * The first process to load a compressed tile decodes all of it into
+ * a shared memory object of raw samples, and every process attached
+ * to the catalogue maps that object instead of decoding chunks into
+ * its own per-thread caches.  Samples are then decoded, and their
+ * pages allocated, once per host rather than once per process.
+ *
+ * The catalogue is an index object, /<name>, with one slot per tile
+ * cell and resolution, plus an object per decoded tile, /<name>.<n>.<g>
+ * for generation g of slot n.  A slot's tile is decoded holding the
+ * slot's lock, a robust process-shared mutex, so processes that find
+ * it being decoded wait on the lock, and if its holder dies the next
+ * to take it decodes the tile afresh.  A ready slot records the
+ * generation of its object and the size and modification time of the
+ * file it was decoded from.  Once that file changes, the next process
+ * to load it decodes it into the next generation's object and removes
+ * the last one's name; processes still mapping the last one keep
+ * their mappings.  Processes holding an older file than the slot's
+ * decode it privately as if there were no catalogue.
+ *
+ * Objects outlive the processes that made them, so the catalogue
+ * stays warm across restarts.  Remove /dev/shm/<name>* to reset it.
+ */
+#include "dem-shm.hh"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "bsdf.hh"
+#include "dem-cache.hh"
+
+/* "DEM" and the index layout version */
+#define DEM_SHM_MAGIC 0x44454d02
+/* The magic while the process that made the index sets up its locks */
+#define DEM_SHM_INIT 0x44454d00
+
+/* How long to wait for another process to set up a new index */
+#define DEM_SHM_INIT_WAIT_MS 5000
+
+/* One slot per cell for each of the 1200 and 3600 IPPD tile sets */
+#define DEM_SHM_SLOTS (2 * DEM_CELL_COUNT)
+
+namespace {
+/* A slot's generation is 0 until its tile has been decoded.  It is
+   also 0 while size and mtime change, so a reader that sees the same
+   non-zero generation before and after reading them read them whole. */
+struct shm_slot {
+    pthread_mutex_t lock;
+    std::atomic<uint32_t> generation;
+    std::atomic<int64_t> size;
+    std::atomic<int64_t> mtime;
+};
+
+struct shm_index {
+    std::atomic<uint32_t> magic;
+    struct shm_slot slot[DEM_SHM_SLOTS];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free
+                  && std::atomic<int64_t>::is_always_lock_free,
+              "slot fields must be usable across processes");
+
+std::mutex G_shm_mtx;
+struct shm_index * G_index = nullptr;
+char G_shm_name[NAME_MAX - 32];
+
+void object_name(int slot, uint32_t generation, char * name, size_t size) {
+    snprintf(name, size, "/%s.%d.%u", G_shm_name, slot, generation);
+}
+
+/* Sets up the locks of a new index. */
+int init_index(struct shm_index * index) {
+    pthread_mutexattr_t attr;
+    int err;
+
+    if ((err = pthread_mutexattr_init(&attr)) != 0) {
+        return -err;
+    }
+
+    if ((err = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED))
+            == 0
+        && (err = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST))
+               == 0) {
+        for (int n = 0; n < DEM_SHM_SLOTS && err == 0; n++) {
+            err = pthread_mutex_init(&index->slot[n].lock, &attr);
+        }
+    }
+
+    pthread_mutexattr_destroy(&attr);
+
+    return -err;
+}
+
+/* Takes a slot's lock.  A holder that died may have left a
+   half-decoded object behind, but never published it, so its
+   generation is simply decoded again. */
+bool lock_slot(struct shm_slot & slot) {
+    int err = pthread_mutex_lock(&slot.lock);
+
+    if (err == EOWNERDEAD) {
+        err = pthread_mutex_consistent(&slot.lock);
+    }
+
+    return err == 0;
+}
+
+/* Decodes the tile in chunks into generation's object for slot. */
+int build(int slot, uint32_t generation, struct dem_chunks const & chunks) {
+    char name[NAME_MAX];
+    size_t bytes = sizeof(short) * chunks.ippd * chunks.ippd;
+
+    object_name(slot, generation, name, sizeof(name));
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    if (fd == -1) {
+        return -errno;
+    }
+
+    if (ftruncate(fd, bytes) == -1) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+
+    void * map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return -errno;
+    }
+
+    bsdf_decode_tile(chunks, (short *)map);
+    munmap(map, bytes);
+
+    return 0;
+}
+
+/* Maps generation's decoded object for slot, or returns null. */
+short * map_object(int slot, uint32_t generation, int ippd, bool populate) {
+    char name[NAME_MAX];
+    size_t bytes = sizeof(short) * ippd * ippd;
+    struct stat st;
+
+    object_name(slot, generation, name, sizeof(name));
+
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size != bytes) {
+        close(fd);
+        return nullptr;
+    }
+
+    void * map = mmap(NULL,
+                      bytes,
+                      PROT_READ,
+                      MAP_SHARED | (populate ? MAP_POPULATE : 0),
+                      fd,
+                      0);
+    close(fd);
+
+    return map == MAP_FAILED ? nullptr : (short *)map;
+}
+} // namespace
+
+/*
+ * dem_shm_attach
+ * Attaches this process to the shared tile catalogue called name,
+ * creating it if no process has yet.  Returns 0 or a negative errno.
+ */
+int dem_shm_attach(const char * name) {
+    char path[NAME_MAX];
+    struct stat st;
+
+    std::lock_guard<std::mutex> lock(G_shm_mtx);
+
+    if (G_index) {
+        return -EBUSY;
+    }
+
+    if (snprintf(G_shm_name, sizeof(G_shm_name), "%s", name)
+            >= (int)sizeof(G_shm_name)
+        || strchr(name, '/')) {
+        return -EINVAL;
+    }
+
+    snprintf(path, sizeof(path), "/%s", G_shm_name);
+
+    int fd = shm_open(path, O_RDWR | O_CREAT, 0600);
+
+    if (fd == -1) {
+        return -errno;
+    }
+
+    /* Every process sizes a new index alike, so racing to do it is
+       harmless, but one of another size is not ours to resize. */
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+
+    if (st.st_size != 0 && (size_t)st.st_size != sizeof(struct shm_index)) {
+        close(fd);
+        return -EINVAL;
+    }
+
+    if (ftruncate(fd, sizeof(struct shm_index)) == -1) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+
+    void * map = mmap(NULL,
+                      sizeof(struct shm_index),
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      fd,
+                      0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return -errno;
+    }
+
+    /* The first process to attach sets the index's locks up, and
+       the others wait for it to. */
+    auto index = (struct shm_index *)map;
+    uint32_t magic = 0;
+    int err = 0;
+
+    if (index->magic.compare_exchange_strong(magic, DEM_SHM_INIT)) {
+        if ((err = init_index(index)) == 0) {
+            magic = DEM_SHM_MAGIC;
+            index->magic.store(magic);
+        }
+    }
+
+    for (int ms = 0; magic == DEM_SHM_INIT && ms < DEM_SHM_INIT_WAIT_MS;
+         ms++) {
+        usleep(1000);
+        magic = index->magic.load();
+    }
+
+    if (err == 0 && magic != DEM_SHM_MAGIC) {
+        err = magic == DEM_SHM_INIT ? -ETIMEDOUT : -EINVAL;
+    }
+
+    if (err != 0) {
+        munmap(map, sizeof(struct shm_index));
+        return err;
+    }
+
+    G_index = index;
+
+    return 0;
+}
+
+/*
+ * dem_shm_share
+ * Switches dem, a freshly mapped v1 tile read from fd, over to the
+ * catalogue's decoded copy of it, decoding and publishing one first
+ * if no process has decoded this version of the file yet.  Returns
+ * whether dem now uses the shared copy; if not, it is left as it was.
+ */
+bool dem_shm_share(int fd, int cell, bool populate, struct dem * dem) {
+    struct shm_index * index;
+    struct stat st;
+
+    {
+        std::lock_guard<std::mutex> lock(G_shm_mtx);
+        index = G_index;
+    }
+
+    if (!index || !dem->chunks || cell < 0 || fstat(fd, &st) == -1) {
+        return false;
+    }
+
+    int n = (2 * cell) + (dem->ippd == 3600 ? 1 : 0);
+    struct shm_slot & slot = index->slot[n];
+    bool locked = false;
+
+    for (;;) {
+        uint32_t generation = slot.generation.load();
+        int64_t size = slot.size.load();
+        int64_t mtime = slot.mtime.load();
+
+        if (generation != 0 && generation == slot.generation.load()) {
+            if (size == (int64_t)st.st_size && mtime == (int64_t)st.st_mtime) {
+                short * data = map_object(n, generation, dem->ippd, populate);
+
+                /* A builder may have moved it on and removed the
+                   name since; if so, look again. */
+                if (!data && generation != slot.generation.load()) {
+                    continue;
+                }
+
+                if (locked) {
+                    pthread_mutex_unlock(&slot.lock);
+                }
+
+                if (!data) {
+                    return false;
+                }
+
+                dem->data = data;
+                dem->chunks.reset();
+                return true;
+            }
+
+            /* Never go back to an older file than the slot's */
+            if (mtime > (int64_t)st.st_mtime) {
+                break;
+            }
+        }
+
+        if (!locked) {
+            /* Look again once any build under way is done */
+            if (!lock_slot(slot)) {
+                return false;
+            }
+
+            locked = true;
+            continue;
+        }
+
+        /* Holding the lock, the slot is ours to move on a generation */
+        uint32_t next = generation + 1 != 0 ? generation + 1 : 1;
+
+        if (build(n, next, *dem->chunks) != 0) {
+            break;
+        }
+
+        uint32_t last = slot.generation.exchange(0);
+
+        slot.size.store(st.st_size);
+        slot.mtime.store(st.st_mtime);
+        slot.generation.store(next);
+
+        if (last != 0) {
+            char name[NAME_MAX];
+
+            object_name(n, last, name, sizeof(name));
+            shm_unlink(name);
+        }
+    }
+
+    if (locked) {
+        pthread_mutex_unlock(&slot.lock);
+    }
+
+    return false;
+}
@@ -0,0 +1,9 @@
+#ifndef _DEM_SHM_HH_
+#define _DEM_SHM_HH_
+
+#include "common.hh"
+
+int dem_shm_attach(const char * name);
+bool dem_shm_share(int fd, int cell, bool populate, struct dem * dem);
+
+#endif /* _DEM_SHM_HH_ */
@@ -0,0 +1,84 @@
+/*
+ * Positions along a great circle at equal steps of arc.  Every radial
+ * of a plot is traced this way, and solving the spherical triangle
+ * afresh for each sample took a dozen calls into libm.  Instead, the
+ * start point p and the unit tangent t heading along the azimuth are
+ * found once; the sample at arc b is then cos(b) p + sin(b) t, and
+ * cos and sin of successive multiples of the step follow from the
+ * angle sum formulae with a few multiply-adds.  Only the conversion
+ * of each point back to latitude and longitude is left to libm.
+ *
+ * Samples are traced GREAT_CIRCLE_LANES at a time, each lane a fixed
+ * number of steps ahead of the previous one, so the recurrence is a
+ * short fixed-length loop over lanes that the compiler vectorises.
+ */
+#include "great-circle.hh"
+
+#include <math.h>
+
+#include "common.hh"
+
+/*
+ * great_circle_trace
+ * Stores in lats and lons the count positions, in degrees, reached
+ * from (lat, lon) by going 0, step, 2 step... along the great circle
+ * that sets off on azimuth.  Angles given are in radians, longitudes
+ * in degrees west, and longitudes stored lie in [0, 360).
+ */
+void great_circle_trace(double lat,
+                        double lon,
+                        double azimuth,
+                        double step,
+                        size_t count,
+                        double * lats,
+                        double * lons) {
+    double slat = sin(lat), clat = cos(lat);
+    double slon = sin(lon), clon = cos(lon);
+    double saz = sin(azimuth), caz = cos(azimuth);
+
+    /* In earth-centred coordinates with x through (0, 0) and y
+       through 90 degrees east, from which longitudes west are
+       measured clockwise.  North and east at the start are
+       (-slat clon, slat slon, clat) and (slon, clon, 0). */
+    double px = clat * clon, py = -clat * slon, pz = slat;
+    double tx = -caz * slat * clon + saz * slon;
+    double ty = caz * slat * slon + saz * clon;
+    double tz = caz * clat;
+
+    double c[GREAT_CIRCLE_LANES], s[GREAT_CIRCLE_LANES];
+
+    for (int k = 0; k < GREAT_CIRCLE_LANES; k++) {
+        c[k] = cos(k * step);
+        s[k] = sin(k * step);
+    }
+
+    double cw = cos(GREAT_CIRCLE_LANES * step);
+    double sw = sin(GREAT_CIRCLE_LANES * step);
+
+    for (size_t i = 0; i < count; i += GREAT_CIRCLE_LANES) {
+        double x[GREAT_CIRCLE_LANES], y[GREAT_CIRCLE_LANES],
+            z[GREAT_CIRCLE_LANES];
+
+        for (int k = 0; k < GREAT_CIRCLE_LANES; k++) {
+            x[k] = c[k] * px + s[k] * tx;
+            y[k] = c[k] * py + s[k] * ty;
+            z[k] = c[k] * pz + s[k] * tz;
+
+            double ck = c[k] * cw - s[k] * sw;
+            s[k] = s[k] * cw + c[k] * sw;
+            c[k] = ck;
+        }
+
+        for (int k = 0; k < GREAT_CIRCLE_LANES && i + k < count; k++) {
+            double west = -atan2(y[k], x[k]);
+            double north = asin(z[k] > 1.0 ? 1.0 : z[k] < -1.0 ? -1.0 : z[k]);
+
+            if (west < 0.0) {
+                west += TWOPI;
+            }
+
+            lats[i + k] = north / DEG2RAD;
+            lons[i + k] = west / DEG2RAD;
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef _GREAT_CIRCLE_HH_
+#define _GREAT_CIRCLE_HH_
+
+#include <stddef.h>
+
+/* Samples traced together, one per vector lane */
+#define GREAT_CIRCLE_LANES 4
+
+void great_circle_trace(double lat,
+                        double lon,
+                        double azimuth,
+                        double step,
+                        size_t count,
+                        double * lats,
+                        double * lons);
+
+#endif /* _GREAT_CIRCLE_HH_ */
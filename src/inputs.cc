@@ -10,17 +10,29 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <memory>
+#include <thread>
+#include <vector>
 
+#include "bsdf.hh"
 #include "common.hh"
+#include "dem-cache.hh"
+#include "dem-catalog.hh"
+#include "dem-overview.hh"
+#include "dem-shm.hh"
+#include "sdf.hh"
 #include "signal-server.hh"
 #include "tiles.hh"
 
 #define BZBUFFER 65536
 #define GZBUFFER 32768
+#define TOPO_LOADERS 8
 
-extern char * G_color_file;
+extern thread_local char * G_color_file;
 
 int loadClutter(char * filename, double radius, struct site tx) {
     /* This function reads a MODIS 17-class clutter file in ASCII Grid format.
@@ -491,6 +503,121 @@ int loadLIDAR(char *filenames, int resample, struct output *out)
 }
 #endif
 
+static void UpdateOutputBounds(struct output * out, struct dem const & dem) {
+    /* This function widens the elevation range and the
+       quadrangle limits of the plot to take in a tile. */
+
+    if (!out) {
+        return;
+    }
+
+    if (dem.min_el < out->min_elevation) {
+        out->min_elevation = dem.min_el;
+    }
+
+    if (dem.max_el > out->max_elevation) {
+        out->max_elevation = dem.max_el;
+    }
+
+    if (out->max_north == -90) {
+        out->max_north = dem.max_north;
+
+    } else if (dem.max_north > out->max_north) {
+        out->max_north = dem.max_north;
+    }
+
+    if (out->min_north == 90) {
+        out->min_north = dem.min_north;
+
+    } else if (dem.min_north < out->min_north) {
+        out->min_north = dem.min_north;
+    }
+
+    if (out->max_west == -1) {
+        out->max_west = dem.max_west;
+
+    } else {
+        if (fabs(dem.max_west - out->max_west) < 180.0) {
+            if (dem.max_west > out->max_west) {
+                out->max_west = dem.max_west;
+            }
+        }
+
+        else {
+            if (dem.max_west < out->max_west) {
+                out->max_west = dem.max_west;
+            }
+        }
+    }
+
+    if (out->min_west == 360) {
+        out->min_west = dem.min_west;
+
+    } else {
+        if (fabs(dem.min_west - out->min_west) < 180.0) {
+            if (dem.min_west < out->min_west) {
+                out->min_west = dem.min_west;
+            }
+        }
+
+        else {
+            if (dem.min_west > out->min_west) {
+                out->min_west = dem.min_west;
+            }
+        }
+    }
+}
+
+static void PinTile(struct output * out,
+                    std::shared_ptr<const struct dem> dem) {
+    /* This function keeps a tile resident for as long as
+       the request that loaded it is in progress. */
+
+    if (!out) {
+        return;
+    }
+
+    for (auto const & pinned : out->dem_pin) {
+        if (pinned == dem) {
+            return;
+        }
+    }
+
+    out->dem_pin.push_back(std::move(dem));
+}
+
+static void UnmapTile(const struct dem * dem) {
+    /* This function releases a tile mapped by LoadSDF_BSDF()
+       once the tile cache and every request are done with it. */
+
+    if (dem->data) {
+        munmap(dem->data, sizeof(int16_t) * dem->ippd * dem->ippd);
+    }
+
+    delete dem;
+}
+
+static void AdviseTile(struct dem const & dem, int policy) {
+    /* This function applies the residency policy to a freshly
+       mapped tile.  Failing only costs performance, so failures
+       are only reported.  Hot tiles are locked into memory as
+       the tile cache takes them. */
+
+    void * map;
+    size_t size;
+
+    dem_cache_tile_mapping(dem, &map, &size);
+
+    if (!map) {
+        return;
+    }
+
+    if ((policy & DEM_POLICY_HUGEPAGE)
+        && madvise(map, size, MADV_HUGEPAGE) == -1 && G_debug) {
+        fprintf(stderr, "MADV_HUGEPAGE failed: %s\n", strerror(errno));
+    }
+}
+
 int LoadSDF_BSDF(char * name, struct output * out) {
     /* This function reads uncompressed ss Data Files (.sdf)
        containing digital elevation model data into memory.
@@ -524,68 +651,10 @@ int LoadSDF_BSDF(char * name, struct output * out) {
     sdf_file[x + 5] = 0;
 
     /* Is it already in memory? */
-    {
-        /* Hold read lock on G_dem while iterating through the vec. */
-        std::shared_lock r_lock(G_dem_mtx);
-
-        for (auto const & dem : G_dem) {
-            if (minlat == dem->min_north && minlon == dem->min_west
-                && maxlat == dem->max_north && maxlon == dem->max_west) {
-                found = 1;
-
-                if (out) {
-                    // TODO copy-pasted from below, dedup
-                    if (dem->min_el < out->min_elevation)
-                        out->min_elevation = dem->min_el;
-
-                    if (dem->max_el > out->max_elevation)
-                        out->max_elevation = dem->max_el;
-
-                    if (out->max_north == -90)
-                        out->max_north = dem->max_north;
-
-                    else if (dem->max_north > out->max_north)
-                        out->max_north = dem->max_north;
-
-                    if (out->min_north == 90)
-                        out->min_north = dem->min_north;
-
-                    else if (dem->min_north < out->min_north)
-                        out->min_north = dem->min_north;
-
-                    if (out->max_west == -1)
-                        out->max_west = dem->max_west;
-
-                    else {
-                        if (abs(dem->max_west - out->max_west) < 180) {
-                            if (dem->max_west > out->max_west)
-                                out->max_west = dem->max_west;
-                        }
-
-                        else {
-                            if (dem->max_west < out->max_west)
-                                out->max_west = dem->max_west;
-                        }
-                    }
-
-                    if (out->min_west == 360)
-                        out->min_west = dem->min_west;
-
-                    else {
-                        if (fabs(dem->min_west - out->min_west) < 180.0) {
-                            if (dem->min_west < out->min_west)
-                                out->min_west = dem->min_west;
-                        }
-
-                        else {
-                            if (dem->min_west > out->min_west)
-                                out->min_west = dem->min_west;
-                        }
-                    }
-                }
-                break;
-            }
-        }
+    if (auto dem = dem_cache_find(minlat, minlon)) {
+        found = 1;
+        UpdateOutputBounds(out, *dem);
+        PinTile(out, dem);
     }
 
     if (found == 0) {
@@ -600,7 +669,23 @@ int LoadSDF_BSDF(char * name, struct output * out) {
             strncpy(path_plus_name, G_sdf_path, sizeof(path_plus_name) - 1);
             strncat(path_plus_name, sdf_file, sizeof(path_plus_name) - 1);
             if ((fd = open(path_plus_name, O_RDONLY)) == -1) {
-                return -errno;
+                /* Last, try the directory legacy SDF files are
+                   transcoded into, if that is another one */
+
+                const char * cache_path = sdf_cache_path();
+
+                if (cache_path == G_sdf_path) {
+                    return -errno;
+                }
+
+                snprintf(path_plus_name,
+                         sizeof(path_plus_name),
+                         "%s%s",
+                         cache_path,
+                         sdf_file);
+                if ((fd = open(path_plus_name, O_RDONLY)) == -1) {
+                    return -errno;
+                }
             }
         }
 
@@ -681,92 +766,91 @@ int LoadSDF_BSDF(char * name, struct output * out) {
         };
 
         int parse_res;
-        FooterV0 footer;
-        if ((parse_res = footer.read(fd)) != 0) {
-            close(fd);
-            return parse_res;
-        }
-
-        struct dem dem;
+        int policy = dem_cache_policy();
+        int map_flags = MAP_PRIVATE;
+        struct dem dem = {};
         dem.min_north = minlat;
         dem.min_west = minlon;
         dem.max_north = maxlat;
         dem.max_west = maxlon;
-        dem.ippd = footer.ippd;
-        dem.min_el = footer.min_el;
-        dem.max_el = footer.max_el;
-
-        /* TODO: need to seek before mapping? */
-        lseek(fd, 0, SEEK_SET);
-        dem.data = (short *)mmap(NULL,
-                                 sizeof(int16_t) * dem.ippd * dem.ippd,
-                                 PROT_READ,
-                                 MAP_PRIVATE,
-                                 fd,
-                                 0);
-
-        close(fd);
-        if (out) {
-            if (dem.min_el < out->min_elevation) {
-                out->min_elevation = dem.min_el;
-            }
 
-            if (dem.max_el > out->max_elevation) {
-                out->max_elevation = dem.max_el;
-            }
+        if (policy & DEM_POLICY_POPULATE) {
+            map_flags |= MAP_POPULATE;
+        }
 
-            if (out->max_north == -90) {
-                out->max_north = dem.max_north;
+        /* Version 1 tiles are stored in chunks, either compressed
+           and decoded on demand or raw in blocked order; see
+           bsdf.cc for their layout. */
 
-            } else if (dem.max_north > out->max_north) {
-                out->max_north = dem.max_north;
-            }
+        /* Tiles whose minimum and maximum elevations are the same
+           hold nothing but that value, so only it is kept. */
 
-            if (out->min_north == 90) {
-                out->min_north = dem.min_north;
+        if (bsdf_version(fd) == BSDF_VERSION_CHUNKED) {
+            parse_res = bsdf_map_chunked(fd, map_flags, &dem);
 
-            } else if (dem.min_north < out->min_north) {
-                out->min_north = dem.min_north;
+            if (parse_res == 0 && dem.min_el == dem.max_el) {
+                dem.chunks.reset();
             }
 
-            if (out->max_west == -1) {
-                out->max_west = dem.max_west;
+            /* Compressed tiles are decoded once per host if there
+               is a shared tile catalogue to decode them into. */
+            if (parse_res == 0 && dem.chunks
+                && dem.chunks->codec != BSDF_CODEC_RAW) {
+                dem_shm_share(fd,
+                              dem_cache_cell(minlat, minlon),
+                              map_flags & MAP_POPULATE,
+                              &dem);
+            }
 
-            } else {
-                if (abs(dem.max_west - out->max_west) < 180) {
-                    if (dem.max_west > out->max_west) {
-                        out->max_west = dem.max_west;
-                    }
-                }
+            close(fd);
 
-                else {
-                    if (dem.max_west < out->max_west) {
-                        out->max_west = dem.max_west;
-                    }
-                }
+            if (parse_res != 0) {
+                return parse_res;
+            }
+        } else {
+            FooterV0 footer;
+            if ((parse_res = footer.read(fd)) != 0) {
+                close(fd);
+                return parse_res;
             }
 
-            if (out->min_west == 360) {
-                out->min_west = dem.min_west;
-
-            } else {
-                if (fabs(dem.min_west - out->min_west) < 180.0) {
-                    if (dem.min_west < out->min_west) {
-                        out->min_west = dem.min_west;
-                    }
+            dem.ippd = footer.ippd;
+            dem.min_el = footer.min_el;
+            dem.max_el = footer.max_el;
+
+            if (dem.min_el != dem.max_el) {
+                /* TODO: need to seek before mapping? */
+                lseek(fd, 0, SEEK_SET);
+                void * map = mmap(NULL,
+                                  sizeof(int16_t) * dem.ippd * dem.ippd,
+                                  PROT_READ,
+                                  map_flags,
+                                  fd,
+                                  0);
+
+                if (map == MAP_FAILED) {
+                    int err = errno;
+                    close(fd);
+                    return -err;
                 }
 
-                else {
-                    if (dem.min_west > out->min_west) {
-                        out->min_west = dem.min_west;
-                    }
-                }
+                dem.data = (short *)map;
             }
+
+            close(fd);
+        }
+
+        if (!dem.uniform()) {
+            dem.overview = std::make_shared<struct dem_overview>();
         }
 
-        std::unique_lock lock(G_dem_mtx);
-        std::shared_ptr<const struct dem> s_dem(new struct dem(dem));
-        G_dem.push_back(s_dem);
+        AdviseTile(dem, policy);
+
+        UpdateOutputBounds(out, dem);
+
+        PinTile(out,
+                dem_cache_insert(std::shared_ptr<const struct dem>(
+                    new struct dem(dem), UnmapTile)));
 
         return 1;
     }
@@ -778,52 +862,41 @@ int LoadSDF_BSDF(char * name, struct output * out) {
 
 int LoadSDF(char * name, struct output * out) {
     /* This function loads the requested SDF file from the filesystem.
-       It first tries to invoke the LoadSDF_SDF() function to load an
-       uncompressed SDF file (since uncompressed files load slightly
-       faster).  If that attempt fails, then it tries to load a
-       compressed SDF file by invoking the LoadSDF_BZ() function.
-       If that attempt fails, then it tries again to load a
-       compressed SDF file by invoking the LoadSDF_GZ() function.
-       If that fails, then we can assume that no elevation data
-       exists for the region requested, and that the region
-       requested must be entirely over water. */
-
-    int minlat, minlon, maxlat, maxlon;
+       It first tries to invoke the LoadSDF_BSDF() function to load a
+       BSDF file.  If there is none, then it looks for a legacy SDF
+       file, uncompressed or compressed with gzip or bzip2, and if it
+       finds one, transcodes it into a BSDF by invoking sdf_transcode()
+       and loads that.  If that fails, or the tile catalogue knows
+       that there is no file for the region at all, then we can assume
+       that no elevation data exists for the region requested, and
+       that the region requested must be entirely over water. */
+
+    int minlat = 0, minlon = 0, maxlat = 0, maxlon = 0;
     char found = 0;
     int return_value = -1;
 
-    return_value = LoadSDF_BSDF(name, out);
-
-    /* Try to load an uncompressed SDF first. */
+    sscanf(name, "%d:%d:%d:%d", &minlat, &maxlat, &minlon, &maxlon);
 
-    // return_value = LoadSDF_SDF(name);
+    /* Tiles the catalogue has no file for are water; don't go
+       looking for them. */
 
-    /* If that fails, try loading a BZ2 compressed SDF. */
+    if (!dem_catalog_absent(minlat, minlon, G_ippd)) {
+        return_value = LoadSDF_BSDF(name, out);
 
-    // if ( return_value <= 0 )
-    //         return_value = LoadSDF_BZ(name);
+        /* If that fails, try transcoding a legacy SDF. */
 
-    /* If that fails, try loading a gzip compressed SDF. */
-
-    // if ( return_value <= 0 )
-    //         return_value = LoadSDF_GZ(name);
+        if (return_value == -ENOENT && sdf_transcode(name) == 0) {
+            return_value = LoadSDF_BSDF(name, out);
+        }
+    }
 
     /* If no file format can be found, then assume the area is water. */
 
     if (return_value <= 0) {
-        sscanf(name, "%d:%d:%d:%d", &minlat, &maxlat, &minlon, &maxlon);
-
         /* Is it already in memory? */
-        {
-            /* Hold an RAII read lock on G_dem while iterating through the vec. */
-            std::shared_lock r_lock(G_dem_mtx);
-            for (auto const & dem : G_dem) {
-                if (minlat == dem->min_north && minlon == dem->min_west
-                    && maxlat == dem->max_north && maxlon == dem->max_west) {
-                    found = 1;
-                    break;
-                }
-            }
+        if (auto dem = dem_cache_find(minlat, minlon)) {
+            found = 1;
+            PinTile(out, dem);
         }
 
         if (found == 0) {
@@ -842,71 +915,10 @@ int LoadSDF(char * name, struct output * out) {
             dem.max_el = 0;
             dem.data = nullptr;
 
-            if (out) {
-                if (dem.min_el > 0) {
-                    dem.min_el = 0;
-                }
-
-                if (dem.min_el < out->min_elevation) {
-                    out->min_elevation = dem.min_el;
-                }
+            UpdateOutputBounds(out, dem);
 
-                if (dem.max_el > out->max_elevation) {
-                    out->max_elevation = dem.max_el;
-                }
-
-                if (out->max_north == -90) {
-                    out->max_north = dem.max_north;
-
-                } else if (dem.max_north > out->max_north) {
-                    out->max_north = dem.max_north;
-                }
-
-                if (out->min_north == 90) {
-                    out->min_north = dem.min_north;
-
-                } else if (dem.min_north < out->min_north) {
-                    out->min_north = dem.min_north;
-                }
-
-                if (out->max_west == -1) {
-                    out->max_west = dem.max_west;
-
-                } else {
-                    if (abs(dem.max_west - out->max_west) < 180) {
-                        if (dem.max_west > out->max_west) {
-                            out->max_west = dem.max_west;
-                        }
-                    }
-
-                    else {
-                        if (dem.max_west < out->max_west) {
-                            out->max_west = dem.max_west;
-                        }
-                    }
-                }
-
-                if (out->min_west == 360) {
-                    out->min_west = dem.min_west;
-
-                } else {
-                    if (abs(dem.min_west - out->min_west) < 180) {
-                        if (dem.min_west < out->min_west) {
-                            out->min_west = dem.min_west;
-                        }
-                    }
-
-                    else {
-                        if (dem.min_west > out->min_west) {
-                            out->min_west = dem.min_west;
-                        }
-                    }
-                }
-            }
-
-            std::unique_lock lock(G_dem_mtx);
-            std::shared_ptr<const struct dem> s_dem(new struct dem(dem));
-            G_dem.push_back(s_dem);
+            PinTile(out,
+                    dem_cache_insert(std::make_shared<const struct dem>(dem)));
 
             return_value = 1;
         }
@@ -931,8 +943,8 @@ int LoadPAT(char * az_filename, char * el_filename, struct LR & lr) {
 
     rotation = 0.0;
 
-    G_got_azimuth_pattern = 0;
-    G_got_elevation_pattern = 0;
+    lr.got_azimuth_pattern = 0;
+    lr.got_elevation_pattern = 0;
 
     /* Load .az antenna pattern file */
 
@@ -1087,7 +1099,7 @@ int LoadPAT(char * az_filename, char * el_filename, struct LR & lr) {
 
         azimuth_pattern[360] = azimuth_pattern[0];
 
-        G_got_azimuth_pattern = 255;
+        lr.got_azimuth_pattern = 255;
     }
 
     /* Read and process .el file */
@@ -1299,17 +1311,17 @@ int LoadPAT(char * az_filename, char * el_filename, struct LR & lr) {
             }
         }
 
-        G_got_elevation_pattern = 255;
+        lr.got_elevation_pattern = 255;
 
         for (x = 0; x <= 360; x++) {
             for (y = 0; y <= 1000; y++) {
-                if (G_got_elevation_pattern) {
+                if (lr.got_elevation_pattern) {
                     elevation = elevation_pattern[x][y];
                 } else {
                     elevation = 1.0;
                 }
 
-                if (G_got_azimuth_pattern) {
+                if (lr.got_azimuth_pattern) {
                     az = azimuth_pattern[x];
                 } else {
                     az = 1.0;
@@ -1876,88 +1888,158 @@ int LoadTopoData(double max_lon,
                  double min_lon,
                  double max_lat,
                  double min_lat,
-                 struct output * out) {
+                 struct output * out,
+                 bool readahead) {
     /* This function loads the SDF files required
-       to cover the limits of the region specified. */
+       to cover the limits of the region specified.
+       Tiles that are not yet in memory are loaded in
+       parallel, nearest to the middle of the region
+       first.  With readahead, for plots, their pages
+       are read ahead so that the sweep faults in as
+       little as possible. */
+
+    struct TopoTile {
+        int lat;
+        int lon;
+        int rank;
+        int result;
+        /* Each tile gets a private output so that its bounds and
+           pin can be merged into out without locking. */
+        struct output scratch;
+    };
 
-    int x, y, width, ymin, ymax;
-    int success;
-    char basename[255] = {0};
-    char string[258] = {0};
+    int x, y, width, ymin, mid_lat;
+    double start_lon;
+    std::vector<TopoTile> pending;
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> loaders;
+    auto started = std::chrono::steady_clock::now();
 
     width = ReduceAngle(max_lon - min_lon);
+    mid_lat = ((int)min_lat + (int)max_lat) / 2;
 
     if ((max_lon - min_lon) <= 180.0) {
-        for (y = 0; y <= width; y++) {
-            for (x = min_lat; x <= (int)max_lat; x++) {
-                ymin = (int)(min_lon + (double)y);
+        start_lon = min_lon;
+    } else {
+        start_lon = max_lon;
+    }
 
-                while (ymin < 0) {
-                    ymin += 360;
-                }
+    for (y = 0; y <= width; y++) {
+        for (x = (int)min_lat; x <= (int)max_lat; x++) {
+            ymin = (int)(start_lon + (double)y);
 
-                while (ymin >= 360) {
-                    ymin -= 360;
-                }
+            while (ymin < 0) {
+                ymin += 360;
+            }
 
-                ymax = ymin + 1;
+            while (ymin >= 360) {
+                ymin -= 360;
+            }
 
-                while (ymax < 0) {
-                    ymax += 360;
-                }
+            /* Resident tiles only need to widen the plot
+               bounds and be pinned; skip naming and parsing them. */
 
-                while (ymax >= 360) {
-                    ymax -= 360;
-                }
+            if (auto dem = dem_cache_find(x, ymin)) {
+                UpdateOutputBounds(out, *dem);
+                PinTile(out, dem);
+                continue;
+            }
 
-                snprintf(basename, 255, "%d:%d:%d:%d", x, x + 1, ymin, ymax);
-                strcpy(string, basename);
+            pending.emplace_back();
+            pending.back().lat = x;
+            pending.back().lon = ymin;
+            pending.back().rank = ((x - mid_lat) * (x - mid_lat))
+                                + ((y - width / 2) * (y - width / 2));
+        }
+    }
 
-                if (G_ippd == 3600) {
-                    strcat(string, "-hd");
-                }
+    std::stable_sort(pending.begin(),
+                     pending.end(),
+                     [](TopoTile const & a, TopoTile const & b) {
+                         return a.rank < b.rank;
+                     });
 
-                if ((success = LoadSDF(string, out)) < 0) {
-                    return -success;
-                }
-            }
-        }
-    } else {
-        for (y = 0; y <= width; y++) {
-            for (x = (int)min_lat; x <= (int)max_lat; x++) {
-                ymin = (int)(max_lon + (double)y);
+    auto loader = [&]() {
+        char string[258] = {0};
 
-                while (ymin < 0) {
-                    ymin += 360;
-                }
+        for (size_t i; (i = next.fetch_add(1)) < pending.size();) {
+            TopoTile & tile = pending[i];
 
-                while (ymin >= 360) {
-                    ymin -= 360;
-                }
+            snprintf(string,
+                     255,
+                     "%d:%d:%d:%d",
+                     tile.lat,
+                     tile.lat + 1,
+                     tile.lon,
+                     (tile.lon + 1) % 360);
 
-                ymax = ymin + 1;
+            if (G_ippd == 3600) {
+                strcat(string, "-hd");
+            }
 
-                while (ymax < 0) {
-                    ymax += 360;
-                }
+            struct dem_faults mark;
 
-                while (ymax >= 360) {
-                    ymax -= 360;
-                }
+            dem_cache_thread_faults(&mark);
+            tile.result = LoadSDF(string, &tile.scratch);
 
-                snprintf(string, 255, "%d:%d:%d:%d", x, x + 1, ymin, ymax);
-                strcpy(string, basename);
+            /* Paths and point lookups only touch a line or a
+               few samples of each tile; reading whole tiles
+               ahead for them only delays the samples they need. */
 
-                if (G_ippd == 3600) {
-                    strcat(string, "-hd");
-                }
+            if (readahead) {
+                for (auto const & dem : tile.scratch.dem_pin) {
+                    void * map;
+                    size_t size;
+
+                    dem_cache_tile_mapping(*dem, &map, &size);
 
-                if ((success = LoadSDF(string, out)) < 0) {
-                    return -success;
+                    if (map) {
+                        madvise(map, size, MADV_WILLNEED);
+                    }
                 }
             }
+
+            dem_cache_count_faults(&tile.scratch.dem_faults, mark);
+        }
+    };
+
+    for (size_t i = 1; i < pending.size() && i < TOPO_LOADERS; i++) {
+        loaders.emplace_back(loader);
+    }
+
+    loader();
+
+    for (auto & thread : loaders) {
+        thread.join();
+    }
+
+    for (auto const & tile : pending) {
+        if (tile.result < 0) {
+            return -tile.result;
+        }
+
+        for (auto const & dem : tile.scratch.dem_pin) {
+            UpdateOutputBounds(out, *dem);
+            PinTile(out, dem);
+        }
+
+        if (out) {
+            out->dem_faults.minor += tile.scratch.dem_faults.minor;
+            out->dem_faults.major += tile.scratch.dem_faults.major;
         }
     }
+
+    if (G_debug == 1 && pending.size()) {
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - started;
+        fprintf(stderr,
+                "Loaded %zu tiles with %zu threads in %.1f ms\n",
+                pending.size(),
+                loaders.size() + 1,
+                elapsed.count());
+        fflush(stderr);
+    }
+
     return 0;
 }
 
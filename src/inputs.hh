@@ -22,7 +22,8 @@ int LoadTopoData(double max_lon,
                  double min_lon,
                  double max_lat,
                  double min_lat,
-                 struct output * out);
+                 struct output * out,
+                 bool readahead);
 int LoadUDT(char * filename);
 int loadLIDAR(char * filename, int resample, struct output * out);
 int loadClutter(char * filename, double radius, struct site tx);
@@ -1,9 +1,14 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <fstream>
 #include <iterator>
 
+#include "dem-cache.hh"
+#include "dem-catalog.hh"
+#include "dem-shm.hh"
+#include "sdf.hh"
 #include "signal-server.hh"
 
 int main(int argc, char * argv[]) {
@@ -31,6 +36,14 @@ int main(int argc, char * argv[]) {
                 "'latitude,longitude,height'\n");
         fprintf(stdout, "     -clt MODIS 17-class wide area clutter in ASCII grid format\n");
         fprintf(stdout, "     -color File to pre-load .scf/.lcf/.dcf for Signal/Loss/dBm color palette\n");
+        fprintf(stdout, "     -maxtiles Maximum number of DEM tiles kept in memory (optional, default unlimited)\n");
+        fprintf(stdout, "     -maxtilemb Maximum megabytes of DEM tiles kept in memory (optional, default unlimited)\n");
+        fprintf(stdout, "     -sdfcache Directory to write BSDF copies of legacy .sdf/.sdf.gz/.sdf.bz2 tiles into (optional, default -sdf directory)\n");
+        fprintf(stdout, "     -shmcache Name of a shared memory tile cache to share decoded DEM tiles with other processes (optional)\n");
+        fprintf(stdout, "     -tilewatch Watch the tile directories for tiles added while running (optional)\n");
+        fprintf(stdout, "     -tilepopulate Fault DEM tiles into memory as they are loaded (optional)\n");
+        fprintf(stdout, "     -tilehugepages Ask for transparent huge pages for DEM tiles (optional)\n");
+        fprintf(stdout, "     -hottiles lat,lon[,km] Lock tiles within km of lat,lon in memory and never evict them (optional, repeatable)\n");
         fprintf(stdout, "Input:\n");
         fprintf(stdout, "     -lat Tx Latitude (decimal degrees) -70/+70\n");
         fprintf(stdout, "     -lon Tx Longitude (decimal degrees) -180/+180\n");
@@ -67,6 +80,9 @@ int main(int argc, char * argv[]) {
         fprintf(stdout, "          10: Plane earth, 11: Egli VHF/UHF, 12: Soil\n");
         fprintf(stdout, "     -pe Propagation model mode: 1=Urban,2=Suburban,3=Rural\n");
         fprintf(stdout, "     -ked Knife edge diffraction (Already on for ITM)\n");
+        fprintf(stdout, "     -ovr Range beyond which ITM uses coarser terrain (miles/kilometers)\n");
+        fprintf(stdout, "     -azbins Radials share a path per azimuth bin (bins, default half a pixel apart at -R)\n");
+        fprintf(stdout, "     -cpfl ITM/ITWOM take terrain profiles in float, half the memory of double\n");
         fprintf(stdout, "Antenna:\n");
         fprintf(stdout, "     -ant (antenna pattern file basename+path for .az and .el files)\n");
         fprintf(stdout, "     -txh Tx Height (above ground)\n");
@@ -82,6 +98,8 @@ int main(int argc, char * argv[]) {
         fprintf(stdout, "     -ng Normalise Path Profile graph\n");
         fprintf(stdout, "     -haf Halve 1 or 2 (optional)\n");
         fprintf(stdout, "     -nothreads Turn off threaded processing\n");
+        fprintf(stdout, "     -threads Threads to sweep with, one per hardware thread if none given\n");
+        fprintf(stdout, "     -ovrchk Report dB deviation of -ovr, -cpfl and radial ITM from full resolution per point\n");
 
         fflush(stdout);
 
@@ -100,6 +118,11 @@ int main(int argc, char * argv[]) {
     G_dpp = 1 / G_ppd;
     G_mpi = G_ippd - 1;
     bool daemon = false;
+    size_t max_tiles = 0, max_tile_bytes = 0;
+    int tile_policy = 0;
+    const char * shm_cache = NULL;
+    const char * sdf_cache = NULL;
+    bool tile_watch = false;
 
     int y = argc - 1;
 
@@ -119,6 +142,100 @@ int main(int argc, char * argv[]) {
         if (strcmp(argv[x], "-daemon") == 0) {
             daemon = true;
         }
+
+        if (strcmp(argv[x], "-maxtiles") == 0) {
+            int z = x + 1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                max_tiles = strtoul(argv[z], NULL, 10);
+            }
+        }
+
+        if (strcmp(argv[x], "-maxtilemb") == 0) {
+            int z = x + 1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                max_tile_bytes = strtoul(argv[z], NULL, 10) << 20;
+            }
+        }
+
+        if (strcmp(argv[x], "-sdfcache") == 0) {
+            int z = x + 1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                sdf_cache = argv[z];
+            }
+        }
+
+        if (strcmp(argv[x], "-shmcache") == 0) {
+            int z = x + 1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                shm_cache = argv[z];
+            }
+        }
+
+        if (strcmp(argv[x], "-tilewatch") == 0) {
+            tile_watch = true;
+        }
+
+        if (strcmp(argv[x], "-tilepopulate") == 0) {
+            tile_policy |= DEM_POLICY_POPULATE;
+        }
+
+        if (strcmp(argv[x], "-tilehugepages") == 0) {
+            tile_policy |= DEM_POLICY_HUGEPAGE;
+        }
+
+        if (strcmp(argv[x], "-hottiles") == 0) {
+            int z = x + 1;
+            double lat, lon, radius = 0.0;
+
+            if (z <= y && argv[z][0]
+                && sscanf(argv[z], "%lf,%lf,%lf", &lat, &lon, &radius) >= 2) {
+                /* Longitudes are given as for -lon */
+                lon = -lon;
+                if (lon < 0.0) {
+                    lon += 360.0;
+                }
+                dem_cache_add_hot(lat, lon, radius);
+            }
+        }
+    }
+
+    dem_cache_set_budget(max_tiles, max_tile_bytes);
+    dem_cache_set_policy(tile_policy);
+
+    if (sdf_cache) {
+        int err = sdf_set_cache_path(sdf_cache);
+
+        if (err) {
+            fprintf(stderr,
+                    "Can't use %s for transcoded tiles: %s\n",
+                    sdf_cache,
+                    strerror(-err));
+            return -err;
+        }
+    }
+
+    /* Without a catalogue every tile is looked for on disk, so
+       failing to make one only costs time. */
+    int catalog_err = tile_watch ? dem_catalog_watch() : dem_catalog_scan();
+
+    if (catalog_err && G_debug) {
+        fprintf(stderr, "Can't catalogue tiles: %s\n", strerror(-catalog_err));
+    }
+
+    if (shm_cache) {
+        int err = dem_shm_attach(shm_cache);
+
+        if (err) {
+            fprintf(stderr,
+                    "Can't attach to shared tile cache %s: %s\n",
+                    shm_cache,
+                    strerror(-err));
+            return -err;
+        }
     }
 
     if (daemon) {
@@ -40,10 +40,13 @@
  *    (-Wunused-but-set-variable)  -- John A. Magliacane -- July 25, 2013      *
  ******************************************************************************/
 
+#include "itwom3.0.hh"
+
 #include <assert.h>
 #include <math.h>
 #include <string.h>
 
+#include <algorithm>
 #include <complex>
 #include <vector>
 
@@ -1657,7 +1660,8 @@ double avar(double zzt, double zzl, double zzc, prop_type & prop, propv_type & p
     return avarv;
 }
 
-void hzns(double pfl[], prop_type & prop) {
+template <typename P>
+void hzns(P const & pfl, prop_type & prop) {
     /* Used only with ITM 1.2.2 */
     bool wq;
     int np;
@@ -1703,7 +1707,8 @@ void hzns(double pfl[], prop_type & prop) {
     }
 }
 
-void hzns2(double pfl[], prop_type & prop) {
+template <typename P>
+void hzns2(P const & pfl, prop_type & prop) {
     bool wq;
     int np, rp, i, j;
     double xi, za, zb, qc, q, sb, sa, dr, dshh;
@@ -1784,7 +1789,12 @@ void hzns2(double pfl[], prop_type & prop) {
     prop.rph = pfl[rp];
 }
 
-void z1sq1(double z[], const double & x1, const double & x2, double & z0, double & zn) {
+template <typename P>
+void z1sq1(P const & z,
+           const double & x1,
+           const double & x2,
+           double & z0,
+           double & zn) {
     /* Used only with ITM 1.2.2 */
     double xn, xa, xb, x, a, b;
     int n, ja, jb;
@@ -1821,7 +1831,12 @@ void z1sq1(double z[], const double & x1, const double & x2, double & z0, double
     zn = a + b * (xn - xb);
 }
 
-void z1sq2(double z[], const double & x1, const double & x2, double & z0, double & zn) {
+template <typename P>
+void z1sq2(P const & z,
+           const double & x1,
+           const double & x2,
+           double & z0,
+           double & zn) {
     /* corrected for use with ITWOM */
     double xn, xa, xb, x, a, b, bn;
     int n, ja, jb;
@@ -1952,10 +1967,11 @@ double qerf(const double & z) {
     return qerfv;
 }
 
-double d1thx(double pfl[], const double & x1, const double & x2) {
+template <typename P>
+double d1thx(P const & pfl, const double & x1, const double & x2) {
     int np, ka, kb, n, k, j;
     double d1thxv, sn, xa, xb;
-    double * s;
+    double s[10 * 25 - 5 + 2]; /* n + 2 for ka at most 25 */
 
     np = (int)pfl[0];
     xa = x1 / pfl[1];
@@ -1971,7 +1987,6 @@ double d1thx(double pfl[], const double & x1, const double & x2) {
     n = 10 * ka - 5;
     kb = n - ka + 1;
     sn = n - 1;
-    s = new double[n + 2];
     s[0] = sn;
     s[1] = 1.0;
     xb = (xb - xa) / sn;
@@ -1998,12 +2013,12 @@ double d1thx(double pfl[], const double & x1, const double & x2) {
 
     d1thxv = qtile(n - 1, s + 2, ka - 1) - qtile(n - 1, s + 2, kb - 1);
     d1thxv /= 1.0 - 0.8 * exp(-(x2 - x1) / 50.0e3);
-    delete[] s;
 
     return d1thxv;
 }
 
-double d1thx2(double pfl[], const double & x1, const double & x2) {
+template <typename P>
+double d1thx2(P const & pfl, const double & x1, const double & x2) {
     int np, ka, kb, n, k, kmx, j;
     double d1thx2v, sn, xa, xb, xc;
 
@@ -2022,7 +2037,10 @@ double d1thx2(double pfl[], const double & x1, const double & x2) {
     n = 10 * ka - 5;
     kb = n - ka + 1;
     sn = n - 1;
-    std::vector<double> s(n + 2, 0.0);
+    /* n is bounded only by the profile's spacing; keep the
+       largest buffer yet rather than allocating one per call. */
+    static thread_local std::vector<double> s;
+    s.assign(n + 2, 0.0);
     s[0] = sn;
     s[1] = 1.0;
     xb = (xb - xa) / sn;
@@ -2053,7 +2071,38 @@ double d1thx2(double pfl[], const double & x1, const double & x2) {
     return d1thx2v;
 }
 
-void qlrpfl(double pfl[],
+/* How point_to_point_ITM() finds the mean height of a profile's
+   middle, its horizons and the lines fitted to it: by going over it */
+struct profile_scan {
+    template <typename P>
+    double zsys(P const & pfl, long ja, long jb) const {
+        double zsys = 0.0;
+
+        for (long i = ja - 1; i < jb; ++i) {
+            zsys += pfl[i];
+        }
+
+        return zsys / (jb - ja + 1);
+    }
+
+    template <typename P>
+    void hzns(P const & pfl, prop_type & prop) const {
+        ::hzns(pfl, prop);
+    }
+
+    template <typename P>
+    void z1sq1(P const & z,
+               const double & x1,
+               const double & x2,
+               double & z0,
+               double & zn) const {
+        ::z1sq1(z, x1, x2, z0, zn);
+    }
+};
+
+template <typename P, typename S>
+void qlrpfl(P const & pfl,
+            S const & scan,
             int klimx,
             int mdvarx,
             prop_type & prop,
@@ -2064,7 +2113,10 @@ void qlrpfl(double pfl[],
 
     prop.dist = pfl[0] * pfl[1];
     np = (int)pfl[0];
-    hzns(pfl, prop);
+    scan.hzns(pfl, prop);
+    /* ascat() needs these, as qlrpfl2() sets them */
+    prop.rch[0] = prop.hg[0] + pfl[2];
+    prop.rch[1] = prop.hg[1] + pfl[np + 2];
 
     for (j = 0; j < 2; j++) {
         xl[j] = mymin(15.0 * prop.hg[j], 0.1 * prop.dl[j]);
@@ -2074,7 +2126,7 @@ void qlrpfl(double pfl[],
     prop.dh = d1thx(pfl, xl[0], xl[1]);
 
     if (prop.dl[0] + prop.dl[1] > 1.5 * prop.dist) {
-        z1sq1(pfl, xl[0], xl[1], za, zb);
+        scan.z1sq1(pfl, xl[0], xl[1], za, zb);
         prop.he[0] = prop.hg[0] + FORTRAN_DIM(pfl[2], za);
         prop.he[1] = prop.hg[1] + FORTRAN_DIM(pfl[np + 2], zb);
 
@@ -2107,8 +2159,8 @@ void qlrpfl(double pfl[],
     }
 
     else {
-        z1sq1(pfl, xl[0], 0.9 * prop.dl[0], za, q);
-        z1sq1(pfl, prop.dist - 0.9 * prop.dl[1], xl[1], q, zb);
+        scan.z1sq1(pfl, xl[0], 0.9 * prop.dl[0], za, q);
+        scan.z1sq1(pfl, prop.dist - 0.9 * prop.dl[1], xl[1], q, zb);
         prop.he[0] = prop.hg[0] + FORTRAN_DIM(pfl[2], za);
         prop.he[1] = prop.hg[1] + FORTRAN_DIM(pfl[np + 2], zb);
     }
@@ -2129,7 +2181,8 @@ void qlrpfl(double pfl[],
     lrprop(0.0, prop, propa);
 }
 
-void qlrpfl2(double pfl[],
+template <typename P>
+void qlrpfl2(P const & pfl,
              int klimx,
              int mdvarx,
              prop_type & prop,
@@ -2242,6 +2295,7 @@ double deg2rad(double d) {
 //* Point-To-Point Mode Calculations
 //***************************************************************************************
 
+template <typename P, typename S>
 void point_to_point_ITM(double tht_m,
                         double rht_m,
                         double eps_dielect,
@@ -2254,8 +2308,9 @@ void point_to_point_ITM(double tht_m,
                         double rel,
                         double & dbloss,
                         char * strmode,
-                        double * elev,
-                        int & errnum)
+                        P const & elev,
+                        int & errnum,
+                        S const & scan)
 
 /******************************************************************************
 
@@ -2293,7 +2348,7 @@ Note that point_to_point has become point_to_point_ITM for use as the old ITM
     double zsys = 0;
     double zc, zr;
     double eno, enso, q;
-    long ja, jb, i, np;
+    long ja, jb, np;
     /* double dkm, xkm; */
     double fs;
 
@@ -2315,18 +2370,13 @@ Note that point_to_point has become point_to_point_ITM for use as the old ITM
     if (q <= 0.0) {
         ja = (long)(3.0 + 0.1 * elev[0]); /* added (long) to correct */
         jb = np - ja + 6;
-
-        for (i = ja - 1; i < jb; ++i) {
-            zsys += elev[i];
-        }
-
-        zsys /= (jb - ja + 1);
+        zsys = scan.zsys(elev, ja, jb);
         q = eno;
     }
 
     propv.mdvar = 12;
     qlrps(frq_mhz, zsys, q, pol, eps_dielect, sgm_conductivity, prop);
-    qlrpfl(elev, propv.klim, propv.mdvar, prop, propa, propv);
+    qlrpfl(elev, scan, propv.klim, propv.mdvar, prop, propa, propv);
     fs = 32.45 + 20.0 * log10(frq_mhz) + 20.0 * log10(prop.dist / 1000.0);
     q = prop.dist - propa.dla;
 
@@ -2352,6 +2402,377 @@ Note that point_to_point has become point_to_point_ITM for use as the old ITM
     errnum = prop.kwx;
 }
 
+template <typename P>
+void point_to_point_ITM(double tht_m,
+                        double rht_m,
+                        double eps_dielect,
+                        double sgm_conductivity,
+                        double eno_ns_surfref,
+                        double frq_mhz,
+                        int radio_climate,
+                        int pol,
+                        double conf,
+                        double rel,
+                        double & dbloss,
+                        char * strmode,
+                        P const & elev,
+                        int & errnum) {
+    point_to_point_ITM(tht_m,
+                       rht_m,
+                       eps_dielect,
+                       sgm_conductivity,
+                       eno_ns_surfref,
+                       frq_mhz,
+                       radio_climate,
+                       pol,
+                       conf,
+                       rel,
+                       dbloss,
+                       strmode,
+                       elev,
+                       errnum,
+                       profile_scan());
+}
+
+/* How far either side of 0.5 gme an itm_radial takes the earth's
+   curvature off its heights by, when they have to be curved again.
+   The wider it is, the less often that is, but the more of the
+   profile may lie between the horizons it brackets the receiver's
+   with. */
+#define ITM_RADIAL_CURVE_WINDOW 1e-3
+
+/* Returns s after it has had d added to it n times over, one at a
+   time, as hzns() moves sa and sb along the profile, to the bit.
+   While s stays within a power of two, each addition rounds d to the
+   same multiple of s's last place, so whole runs of them are made at
+   once; those that cross a power of two, or that round a tie, are
+   made one at a time. */
+static double accumulate(double s, double d, long n) {
+    while (n > 0) {
+        int e;
+        double u, t, step;
+        long m = 0;
+
+        if (s > 0.0) {
+            frexp(s, &e);
+            u = ldexp(1.0, e - 53);
+            t = d / u;
+
+            if (t - floor(t) != 0.5) {
+                step = rint(t) * u;
+                m = (long)((d > 0.0 ? ldexp(1.0, e) - s
+                                    : s - ldexp(1.0, e - 1))
+                           / fabs(step))
+                    - 2;
+                m = min(max(m, 0L), n);
+                s += m * step;
+            }
+        }
+
+        if (m == 0) {
+            s += d;
+            m = 1;
+        }
+
+        n -= m;
+    }
+
+    return s;
+}
+
+/* Adds point i to the upper hull of the points (i, y[i]) */
+static void hull_add(std::vector<long> & hull,
+                     std::vector<double> const & y,
+                     long i) {
+    while (hull.size() >= 2) {
+        long a = hull[hull.size() - 2], b = hull.back();
+
+        if ((b - a) * (y[i] - y[a]) - (y[b] - y[a]) * (i - a) < 0.0) {
+            break;
+        }
+
+        hull.pop_back();
+    }
+
+    hull.push_back(i);
+}
+
+/* Returns the first point on hull highest above a line of slope m,
+   which is the first point of any for which y[i] - m i is greatest */
+static long hull_top(std::vector<long> const & hull,
+                     std::vector<double> const & y,
+                     double m) {
+    size_t lo = 0, hi = hull.size() - 1;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        long a = hull[mid], b = hull[mid + 1];
+
+        if (y[b] - y[a] > m * (b - a)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return hull[lo];
+}
+
+/* Returns the first point on hull seen highest from (x, z), to the
+   right of them all, which is the first point of any for which
+   (y[i] - z) / (x - i) is greatest */
+static long hull_tangent(std::vector<long> const & hull,
+                         std::vector<double> const & y,
+                         double x,
+                         double z) {
+    size_t lo = 0, hi = hull.size() - 1;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        long a = hull[mid], b = hull[mid + 1];
+
+        if ((y[b] - y[a]) * (x - a) > (z - y[a]) * (b - a)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return hull[lo];
+}
+
+/* How itm_radial::point_to_point_ITM() finds the same, from what it
+   has carried out to the profile's end */
+struct radial_scan {
+    itm_radial & radial;
+
+    template <typename P>
+    double zsys(P const & /* pfl */, long ja, long jb) const {
+        return (radial.sum[jb - 2] - radial.sum[ja - 3]) / (jb - ja + 1);
+    }
+
+    /* hzns() moves the transmitter horizon out to each point that
+       rises above it, so it ends at the first point of those the
+       transmitter sees highest, which is where the slope to a point,
+       less qc times its distance, is greatest.  It only looks for the
+       receiver horizon from the first point that rises above the line
+       between the ends, but points before that are below the same line
+       seen from the receiver, so that is the first point the receiver
+       sees highest of all. */
+    template <typename P>
+    void hzns(P const & pfl, prop_type & prop) const {
+        long np, i, lo, hi;
+        double xi, za, zb, qc, q, sa, sb;
+
+        np = (long)pfl[0];
+        xi = pfl[1];
+        za = pfl[2] + prop.hg[0];
+        zb = pfl[np + 2] + prop.hg[1];
+        qc = 0.5 * prop.gme;
+        q = qc * prop.dist;
+        prop.the[1] = (zb - za) / prop.dist;
+        prop.the[0] = prop.the[1] - q;
+        prop.the[1] = -prop.the[1] - q;
+        prop.dl[0] = prop.dist;
+        prop.dl[1] = prop.dist;
+
+        if (np < 2) {
+            return;
+        }
+
+        i = hull_top(radial.rising, radial.slope, qc * radial.xi);
+        sa = accumulate(0.0, xi, i);
+        q = pfl[i + 2] - (qc * sa + prop.the[0]) * sa - za;
+
+        if (q <= 0.0) {
+            return;
+        }
+
+        prop.the[0] += q / sa;
+        prop.dl[0] = sa;
+
+        if (!(qc >= radial.qc[0] && qc <= radial.qc[1])) {
+            radial.qc[0] = qc * (1.0 - ITM_RADIAL_CURVE_WINDOW);
+            radial.qc[1] = qc * (1.0 + ITM_RADIAL_CURVE_WINDOW);
+
+            for (int j = 0; j < 2; j++) {
+                radial.setting[j].clear();
+
+                for (long k = 1; k < np; k++) {
+                    sa = k * radial.xi;
+                    radial.curved[j][k] = pfl[k + 2] - radial.qc[j] * sa * sa;
+                    hull_add(radial.setting[j], radial.curved[j], k);
+                }
+            }
+        }
+
+        /* The less the earth curves, the further back the receiver
+           sees highest, so its horizon lies between those it has at
+           either end of the window; mostly they are the same point. */
+        lo = hull_tangent(radial.setting[0],
+                          radial.curved[0],
+                          prop.dist / radial.xi,
+                          zb - radial.qc[0] * prop.dist * prop.dist);
+        hi = hull_tangent(radial.setting[1],
+                          radial.curved[1],
+                          prop.dist / radial.xi,
+                          zb - radial.qc[1] * prop.dist * prop.dist);
+        i = lo;
+
+        if (lo != hi) {
+            double best = -HUGE_VAL;
+
+            for (long k = min(lo, hi); k <= max(lo, hi); k++) {
+                sb = prop.dist - k * radial.xi;
+                q = (pfl[k + 2] - zb) / sb - qc * sb;
+
+                if (q > best) {
+                    best = q;
+                    i = k;
+                }
+            }
+        }
+
+        sb = accumulate(prop.dist, -xi, i);
+        q = pfl[i + 2] - (qc * sb + prop.the[1]) * sb - zb;
+
+        if (q > 0.0) {
+            prop.the[1] += q / sb;
+            prop.dl[1] = sb;
+        }
+    }
+
+    /* z1sq1(), with the sums over the points between the ends of the
+       fit taken from the running sums */
+    template <typename P>
+    void z1sq1(P const & z,
+               const double & x1,
+               const double & x2,
+               double & z0,
+               double & zn) const {
+        double xn, xa, xb, x, a, b, inner;
+        int ja, jb;
+
+        xn = z[0];
+        xa = int(FORTRAN_DIM(x1 / z[1], 0.0));
+        xb = xn - int(FORTRAN_DIM(xn, x2 / z[1]));
+
+        if (xb <= xa) {
+            xa = FORTRAN_DIM(xa, 1.0);
+            xb = xn - FORTRAN_DIM(xn, xb + 1.0);
+        }
+
+        ja = (int)xa;
+        jb = (int)xb;
+        xa = xb - xa;
+        x = -0.5 * xa;
+        xb += x;
+
+        a = 0.5 * (z[ja + 2] + z[jb + 2]);
+        b = 0.5 * (z[ja + 2] - z[jb + 2]) * x;
+
+        if (jb - ja >= 2) {
+            inner = radial.sum[jb] - radial.sum[ja + 1];
+            a += inner;
+            b += radial.moment[jb] - radial.moment[ja + 1] - xb * inner;
+        }
+
+        a /= xa;
+        b = b * 12.0 / ((xa * xa + 2.0) * xa);
+        z0 = a - b * xb;
+        zn = a + b * (xn - xb);
+    }
+};
+
+void itm_radial::start() {
+    sum.clear();
+    moment.clear();
+    slope.clear();
+    rising.clear();
+
+    for (int j = 0; j < 2; j++) {
+        curved[j].clear();
+        setting[j].clear();
+    }
+}
+
+void itm_radial::reserve(size_t points) {
+    sum.reserve(points + 1);
+    moment.reserve(points + 1);
+    slope.reserve(points);
+    rising.reserve(points);
+
+    for (int j = 0; j < 2; j++) {
+        curved[j].reserve(points);
+        setting[j].reserve(points);
+    }
+}
+
+template <typename P>
+void itm_radial::point_to_point_ITM(double tht_m,
+                                    double rht_m,
+                                    double eps_dielect,
+                                    double sgm_conductivity,
+                                    double eno_ns_surfref,
+                                    double frq_mhz,
+                                    int radio_climate,
+                                    int pol,
+                                    double conf,
+                                    double rel,
+                                    double & dbloss,
+                                    char * strmode,
+                                    P const & elev,
+                                    int & errnum) {
+    long np = (long)elev[0];
+
+    if (sum.empty()) {
+        xi = elev[1];
+        za = elev[2] + tht_m;
+        qc[0] = qc[1] = 0.0;
+        sum.push_back(0.0);
+        moment.push_back(0.0);
+        slope.push_back(0.0);
+        curved[0].push_back(0.0);
+        curved[1].push_back(0.0);
+    }
+
+    /* The running sums reach the end of the profile, and the hulls
+       the point before it */
+    for (long k = sum.size() - 1; k <= np; k++) {
+        sum.push_back(sum[k] + elev[k + 2]);
+        moment.push_back(moment[k] + k * elev[k + 2]);
+    }
+
+    for (long i = slope.size(); i < np; i++) {
+        double sa = i * xi;
+
+        slope.push_back((elev[i + 2] - za) / sa);
+        hull_add(rising, slope, i);
+
+        for (int j = 0; j < 2; j++) {
+            curved[j].push_back(elev[i + 2] - qc[j] * sa * sa);
+            hull_add(setting[j], curved[j], i);
+        }
+    }
+
+    ::point_to_point_ITM(tht_m,
+                         rht_m,
+                         eps_dielect,
+                         sgm_conductivity,
+                         eno_ns_surfref,
+                         frq_mhz,
+                         radio_climate,
+                         pol,
+                         conf,
+                         rel,
+                         dbloss,
+                         strmode,
+                         elev,
+                         errnum,
+                         radial_scan{*this});
+}
+
+template <typename P>
 void point_to_point(double tht_m,
                     double rht_m,
                     double eps_dielect,
@@ -2364,7 +2785,7 @@ void point_to_point(double tht_m,
                     double rel,
                     double & dbloss,
                     char * strmode,
-                    double * elev,
+                    P const & elev,
                     int & errnum)
 
 /******************************************************************************
@@ -2507,6 +2928,92 @@ void point_to_point(double tht_m,
     errnum = prop.kwx;
 }
 
+/* Profiles are taken in double or, at half the size, in float */
+template void point_to_point_ITM(double,
+                                 double,
+                                 double,
+                                 double,
+                                 double,
+                                 double,
+                                 int,
+                                 int,
+                                 double,
+                                 double,
+                                 double &,
+                                 char *,
+                                 double * const &,
+                                 int &);
+template void point_to_point_ITM(double,
+                                 double,
+                                 double,
+                                 double,
+                                 double,
+                                 double,
+                                 int,
+                                 int,
+                                 double,
+                                 double,
+                                 double &,
+                                 char *,
+                                 float_profile const &,
+                                 int &);
+template void point_to_point(double,
+                             double,
+                             double,
+                             double,
+                             double,
+                             double,
+                             int,
+                             int,
+                             double,
+                             double,
+                             double &,
+                             char *,
+                             double * const &,
+                             int &);
+template void point_to_point(double,
+                             double,
+                             double,
+                             double,
+                             double,
+                             double,
+                             int,
+                             int,
+                             double,
+                             double,
+                             double &,
+                             char *,
+                             float_profile const &,
+                             int &);
+template void itm_radial::point_to_point_ITM(double,
+                                             double,
+                                             double,
+                                             double,
+                                             double,
+                                             double,
+                                             int,
+                                             int,
+                                             double,
+                                             double,
+                                             double &,
+                                             char *,
+                                             double * const &,
+                                             int &);
+template void itm_radial::point_to_point_ITM(double,
+                                             double,
+                                             double,
+                                             double,
+                                             double,
+                                             double,
+                                             int,
+                                             int,
+                                             double,
+                                             double,
+                                             double &,
+                                             char *,
+                                             float_profile const &,
+                                             int &);
+
 void point_to_pointMDH_two(double tht_m,
                            double rht_m,
                            double eps_dielect,
@@ -1,6 +1,27 @@
 #ifndef _ITWOM30_HH_
 #define _ITWOM30_HH_
 
+#include <stddef.h>
+
+#include <vector>
+
+/* A profile laid out as point_to_point() takes it, but with its
+   heights in float.  The point count and spacing stay in double:
+   rounding the spacing shifts every point along the path, which can
+   be enough to move ITM's horizons. */
+struct float_profile {
+    double points;
+    double step;
+    /* pfl[i] is elev[i] for i >= 2 */
+    const float * pfl;
+
+    double operator[](long i) const {
+        return i >= 2 ? pfl[i] : (i == 1 ? step : points);
+    }
+};
+
+/* elev is a double * or a float_profile */
+template <typename P>
 void point_to_point_ITM(double tht_m,
                         double rht_m,
                         double eps_dielect,
@@ -13,8 +34,9 @@ void point_to_point_ITM(double tht_m,
                         double rel,
                         double & dbloss,
                         char * strmode,
-                        double * elev,
+                        P const & elev,
                         int & errnum);
+template <typename P>
 void point_to_point(double tht_m,
                     double rht_m,
                     double eps_dielect,
@@ -27,7 +49,54 @@ void point_to_point(double tht_m,
                     double rel,
                     double & dbloss,
                     char * strmode,
-                    double * elev,
+                    P const & elev,
                     int & errnum);
 
+/* point_to_point_ITM() for each point out along one profile in turn,
+   as a radial's points are analysed.  Rather than going over the
+   profile afresh for every point, the mean height of its middle, the
+   lines fitted to it and its horizons are carried from one point to
+   the next as running sums and upper hulls; only the terrain
+   roughness and the model itself are worked out for each point.
+   Horizons are found at the same points and distances, so losses
+   only differ from point_to_point_ITM()'s by rounding in the sums,
+   well under 1e-6 dB. */
+struct itm_radial {
+    /* sum[k] and moment[k] are the sums of the heights before the kth
+       point, and of each times its index */
+    std::vector<double> sum, moment;
+    /* The slope to each point from the transmitter, and its height
+       with the earth's curvature taken off, by qc[0] and by qc[1] */
+    std::vector<double> slope, curved[2];
+    /* The points on the upper hulls of each of those */
+    std::vector<long> rising, setting[2];
+    /* The spacing and transmitter height the profile started with.
+       xi only lays the hulls out; distances are taken from each
+       profile's own spacing, which only differs from it by rounding,
+       so the hulls still order the points as they would be ordered. */
+    double xi, za, qc[2];
+
+    /* Starts a new profile */
+    void start();
+    void reserve(size_t points);
+
+    /* Takes elev to be the profile given last, or since start(), taken
+       out to more points */
+    template <typename P>
+    void point_to_point_ITM(double tht_m,
+                            double rht_m,
+                            double eps_dielect,
+                            double sgm_conductivity,
+                            double eno_ns_surfref,
+                            double frq_mhz,
+                            int radio_climate,
+                            int pol,
+                            double conf,
+                            double rel,
+                            double & dbloss,
+                            char * strmode,
+                            P const & elev,
+                            int & errnum);
+};
+
 #endif /* _ITWOM30_HH_ */
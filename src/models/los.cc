@@ -1,12 +1,22 @@
 #include "los.hh"
 
+#include <limits.h>
 #include <math.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "../coverage.hh"
+#include "../dem-cache.hh"
+#include "../dem-overview.hh"
+#include "../great-circle.hh"
 #include "../signal-server.hh"
 #include "cost.hh"
 #include "ecc33.hh"
@@ -19,37 +29,300 @@
 #include "soil.hh"
 #include "sui.hh"
 
-#define NUM_SECTIONS 4
+/* Radials a sweep's workers claim at a time */
+#define SWEEP_CHUNK 32
+
+/* A pixel's claim holds the index of the radial that analysed it
+   above the 8 bit value that radial found; an unclaimed pixel's is
+   all ones, so sweeps of more radials than this go unclaimed. */
+#define CLAIM_NONE UINT32_MAX
+#define CLAIM_RADIALS (CLAIM_NONE >> 8)
 
 namespace {
-pthread_t threads[NUM_SECTIONS];
-unsigned int thread_count = 0;
-pthread_mutex_t maskMutex;
-bool *** processed;
-bool has_init_processed = true; // XXX hacked for now because we don't use threads
-
-struct propagationRange {
-    double min_west, max_west, min_north, max_north;
+struct propagationSweep;
+
+/* How far a thread's radials reached: the furthest north and, in
+   samples, out that they analysed, and the strongest signal (or
+   greatest loss) they left, for the plot's crop and colours */
+struct sweepReach {
+    double crop_lat;
+    double crop_lon;
+    int hottest;
+};
+
+/* Deviation of overview profiles from full resolution, for -ovrchk */
+struct overviewDeviation {
+    unsigned long points;
+    double sum;
+    double sum2;
+    double max;
+};
+
+/* One thread's part in a sweep.  Its radials are handed out from
+   span, which packs the first unclaimed one in the low half and one
+   past the last in the high half, so that the worker taking chunks
+   off the front and others stealing from the back agree with a single
+   compare-and-swap. */
+struct sweepWorker {
+    propagationSweep * sweep;
+    std::atomic<uint64_t> span;
+    /* Faults the worker's paths took sampling terrain */
+    struct dem_faults faults;
+    struct sweepReach reach;
+    struct overviewDeviation deviation;
+    /* Radials swept, paths traced for them and the terrain samples
+       those took and, roughly, spared by sharing azimuth bins */
+    unsigned long radials, paths, samples, shared_samples;
+    /* Pixels its radials crossed, analysed, and found an earlier
+       radial had analysed */
+    unsigned long crossed, claimed, forgone;
+};
+
+/* Radials from source out to each point along the edge of the plot */
+struct propagationSweep {
     double altitude;
-    bool eastwest, los, use_threads;
+    bool los;
     site source;
     unsigned char mask_value;
     FILE * fd;
     int propmodel, knifeedge, pmenv;
     struct output * out;
     LR const * lr;
+    /* The edge points (lat, lon), in the order they are swept to */
+    std::vector<std::pair<double, double>> edges;
+    /* The most samples any radial's path can take */
+    size_t samples;
+    /* A claim for each pixel of the output's coverage, by the
+       earliest radial in sweep order to analyse it */
+    std::vector<std::atomic<uint32_t>> claims;
+    std::vector<sweepWorker> workers;
 };
 
-void * rangePropagation(void * parameters) {
-    propagationRange * v = (propagationRange *)parameters;
-    /*if (v->use_threads) {
-        alloc_elev();
-        alloc_path();
-    }*/
+/* Faults this thread has taken sampling path terrain; each worker
+   reports its share in its faults. */
+thread_local struct dem_faults G_path_faults;
+
+/* How far this thread's radials have reached; each worker reports
+   it in its reach. */
+thread_local struct sweepReach G_reach;
+
+/* The deviation this thread's radials have seen, for its worker's
+   deviation */
+thread_local struct overviewDeviation G_overview_dev;
+
+/* The claims of the sweep this thread's radials are part of, if any,
+   the index of the radial it is sweeping, and how many pixels its
+   radials have crossed, analysed and forgone */
+thread_local std::atomic<uint32_t> * G_claims;
+thread_local uint32_t G_radial;
+thread_local unsigned long G_crossed, G_claimed, G_forgone;
+
+/* Returns whether this thread's radial should analyse the pixel of
+   out at (lat, lon): false if it, or a radial before it in the sweep,
+   already has.  Near the source, many radials cross each pixel, and
+   as when sweeping in order, the first of them decides its value
+   however the radials are shared among threads.  Pixels off the
+   coverage are analysed by every radial, as are those of radials
+   swept on their own. */
+bool ClaimPixel(struct output const * out, double lat, double lon) {
+    long pixel = coverage_pixel(out->coverage, lat, lon);
+
+    if (G_claims == nullptr || pixel < 0) {
+        return true;
+    }
+
+    if ((G_claims[pixel].load(std::memory_order_relaxed) >> 8) <= G_radial) {
+        G_forgone++;
+        return false;
+    }
+
+    G_claimed++;
+    return true;
+}
+
+/* Leaves value as what this thread's radial found at (lat, lon) of
+   out: the signal, or with loss the path loss.  In a sweep, it goes
+   in the pixel's claim unless a radial before this one has left its
+   own there, and RunSweep() writes the claims out once every radial
+   is done.  Otherwise it goes straight into the output. */
+void LeaveSignal(struct output * out,
+                 double lat,
+                 double lon,
+                 unsigned char value,
+                 bool loss,
+                 unsigned char mask_value) {
+    long pixel =
+        G_claims == nullptr ? -1 : coverage_pixel(out->coverage, lat, lon);
+
+    if (pixel >= 0) {
+        uint32_t claim = (G_radial << 8) | value;
+        uint32_t old = G_claims[pixel].load(std::memory_order_relaxed);
+
+        while (claim < old
+               && !G_claims[pixel].compare_exchange_weak(
+                   old, claim, std::memory_order_relaxed)) {
+        }
+
+        return;
+    }
+
+    value = loss ? MinSignal(out, lat, lon, value)
+                 : MaxSignal(out, lat, lon, value);
+    G_reach.hottest = MAX(G_reach.hottest, value);
+    UpdateMask(out, lat, lon, 248, mask_value << 3);
+}
+
+/* What a thread's radials are traced and analysed in.  Each radial
+   refills it, so once it has room for a sweep's longest path the
+   sweep allocates nothing from one radial to the next. */
+struct PathBuffers {
+    Path path;
+    PathSight sight;
+    std::vector<double> overview[DEM_OVERVIEW_LEVELS + 1];
+    std::vector<double> coarse;
+    /* The profiles the terrain models are given, in place of the
+       output's, which threads would share.  With -cpfl they are given
+       the heights in float instead, and elev is only built when
+       knife edge diffraction or -ovrchk need it. */
+    std::vector<double> elev;
+    std::vector<float> compact;
+    std::vector<float> compact_coarse;
+    /* What ITM carries from one point of elev to the next */
+    itm_radial itm;
+
+    void reserve(size_t samples) {
+        path.reserve(samples);
+        sight.reserve(samples);
+
+        for (int level = 1; level <= DEM_OVERVIEW_LEVELS; level++) {
+            overview[level].reserve(samples);
+        }
+
+        coarse.reserve(samples / 2 + 3);
+        compact.reserve(samples + 3);
+        compact_coarse.reserve(samples / 2 + 3);
+        elev.reserve(samples + 2);
+        itm.reserve(samples);
+    }
+};
+
+thread_local PathBuffers G_path_buffers;
+
+/* Traces the path from source to destination into this thread's
+   buffers, counting the faults sampling its terrain takes in
+   G_path_faults, and returns the buffers. */
+PathBuffers & TracePath(site const & source, site const & destination) {
+    struct dem_faults mark;
+    PathBuffers & buffers = G_path_buffers;
+
+    dem_cache_thread_faults(&mark);
+    buffers.path.trace(source, destination);
+    dem_cache_count_faults(&G_path_faults, mark);
+
+    return buffers;
+}
+
+/* Returns how many bins of azimuth lr asks radials to share.  Unless
+   it says, they are half a pixel apart at the plot's radius; bins a
+   whole pixel apart leave gaps between their paths there. */
+int AzimuthBins(LR const * lr, site const & source) {
+    if (lr->azimuth_bins >= 0) {
+        return lr->azimuth_bins;
+    }
+
+    double pixel = 3959.0 * G_dpp * DEG2RAD * cos(source.lat * DEG2RAD);
+
+    return (int)ceil(2.0 * TWOPI * lr->max_range / pixel);
+}
+
+/* Returns the point as far from source as edge is, but in the middle
+   of bin, one of bins equal bins of azimuth. */
+site BinTarget(site const & source, site const & edge, int bin, int bins) {
+    double lats[2], lons[2];
+    site target = edge;
+
+    great_circle_trace(source.lat * DEG2RAD,
+                       source.lon * DEG2RAD,
+                       (bin + 0.5) * TWOPI / bins,
+                       Distance(source, edge) / 3959.0,
+                       2,
+                       lats,
+                       lons);
+    target.lat = lats[1];
+    target.lon = lons[1];
+
+    return target;
+}
 
-    double minwest = G_dpp + (double)v->min_west;
-    double lon = v->eastwest ? minwest : v->min_west;
-    double lat = v->min_north;
+/* Reports, for -dbg, how the sweep's radials were shared out among
+   its workers and how much sharing azimuth bins spared them */
+void ReportRadials(propagationSweep const & sweep, int bins) {
+    unsigned long radials = 0, paths = 0, samples = 0, shared_samples = 0;
+    unsigned long least = ULONG_MAX, most = 0;
+
+    if (!G_debug) {
+        return;
+    }
+
+    for (auto const & w : sweep.workers) {
+        radials += w.radials;
+        paths += w.paths;
+        samples += w.samples;
+        shared_samples += w.shared_samples;
+        least = std::min(least, w.radials);
+        most = std::max(most, w.radials);
+    }
+
+    fprintf(stderr,
+            "Swept %lu radials on %zu threads, %lu to %lu each\n",
+            radials,
+            sweep.workers.size(),
+            least,
+            most);
+
+    if (!sweep.los) {
+        unsigned long crossed = 0, claimed = 0, forgone = 0;
+
+        for (auto const & w : sweep.workers) {
+            crossed += w.crossed;
+            claimed += w.claimed;
+            forgone += w.forgone;
+        }
+
+        fprintf(stderr,
+                "Radials crossed %lu pixels and analysed %lu, sparing "
+                "%lu analyses of pixels an earlier radial had analysed\n",
+                crossed,
+                claimed,
+                forgone);
+    }
+
+    if (bins > 0) {
+        fprintf(stderr,
+                "Azimuth bins: %d, %lu paths traced for %lu radials, "
+                "%lu terrain samples taken and about %lu spared\n",
+                bins,
+                paths,
+                radials,
+                samples,
+                shared_samples);
+    }
+
+    fflush(stderr);
+}
+
+/* Adds to sweep the points along one edge of the plot, from
+   (min_north, min_west) to (max_north, max_west), that radials are
+   swept to, and notes the most samples their paths can take. */
+void AddEdge(propagationSweep & sweep,
+             double min_west,
+             double max_west,
+             double min_north,
+             double max_north) {
+    bool eastwest = min_west != max_west;
+    double minwest = G_dpp + min_west;
+    double lon = eastwest ? minwest : min_west;
+    double lat = min_north;
     int y = 0;
 
     do {
@@ -57,131 +330,441 @@ void * rangePropagation(void * parameters) {
             lon -= 360.0;
         }
 
-        site edge;
-        edge.lat = lat;
-        edge.lon = lon;
-        edge.alt = v->altitude;
+        /* Path::trace() takes a sample per pixel along the longer of
+           the two axes, give or take one at either end. */
+        double span = fabs(lat - sweep.source.lat)
+                    + fabs(LonDiff(lon, sweep.source.lon));
+        size_t samples = (size_t)(G_ppd * span) + 3;
 
-        if (v->los) {
-            PlotLOSPath(v->out, v->source, edge, v->mask_value, v->lr);
-        } else {
-            PlotPropPath(v->out,
-                         v->source,
-                         edge,
-                         v->mask_value,
-                         v->fd,
-                         v->propmodel,
-                         v->knifeedge,
-                         v->pmenv,
-                         v->lr);
-        }
+        sweep.edges.emplace_back(lat, lon);
+        sweep.samples =
+            std::max(sweep.samples, std::min(samples, (size_t)ARRAYSIZE));
 
         ++y;
-        if (v->eastwest) {
+        if (eastwest) {
             lon = minwest + (G_dpp * (double)y);
         } else {
-            lat = (double)v->min_north + (G_dpp * (double)y);
+            lat = min_north + (G_dpp * (double)y);
         }
 
-    } while (v->eastwest ? (LonDiff(lon, (double)v->max_west) <= 0.0)
-                         : (lat < (double)v->max_north));
-
-    /*if (v->use_threads) {
-        free_elev();
-        free_path();
-    }*/
-    return NULL;
+    } while (eastwest ? (LonDiff(lon, max_west) <= 0.0) : (lat < max_north));
 }
 
-void init_processed() {
-    // XXX hacked for now
-    /*int i;
-    int x;
-    int y;
+/* Adds the edges of out's plot to sweep in the order they have always
+   been swept in: north edge east to west, east edge south to north,
+   south edge east to west and west edge south to north.  haf 1 or 2
+   keeps only the first or the last two, for half a plot. */
+void AddEdges(propagationSweep & sweep, struct output const * out, int haf) {
+    double east = out->min_west, west = out->max_west;
+    double south = out->min_north, north = out->max_north;
+
+    sweep.edges.reserve(
+        (size_t)(2.0 * G_ppd * ((north - south) + fabs(LonDiff(west, east))))
+        + 8);
+
+    if (haf != 2) {
+        AddEdge(sweep, east, west, north, north);
+        AddEdge(sweep, east, east, south, north);
+    }
 
-    processed = new bool **[MAXPAGES];
-    for (i = 0; i < MAXPAGES; i++) {
-            processed[i] = new bool *[G_ippd];
-            for (x = 0; x < G_ippd; x++)
-                    processed[i][x] = new bool [G_ippd];
+    if (haf != 1) {
+        AddEdge(sweep, east, west, south, south);
+        AddEdge(sweep, west, west, south, north);
     }
+}
+
+inline uint64_t Span(uint64_t first, uint64_t last) {
+    return first | (last << 32);
+}
 
-    for (i = 0; i < MAXPAGES; i++) {
-            for (x = 0; x < G_ippd; x++) {
-                    for (y = 0; y < G_ippd; y++)
-                            processed[i][x][y] = false;
+/* Claims the next radials, first to last, for w: a chunk off the
+   front of its own, or once those are gone, half of what the worker
+   with the most left still has, taken from the back.  Returns false
+   when every radial of the sweep is claimed. */
+bool ClaimRadials(sweepWorker & w, size_t & first, size_t & last) {
+    for (;;) {
+        uint64_t span = w.span.load(std::memory_order_acquire);
+
+        while ((uint32_t)span < (span >> 32)) {
+            uint64_t begin = (uint32_t)span, end = span >> 32;
+            uint64_t take = std::min(end - begin, (uint64_t)SWEEP_CHUNK);
+
+            if (w.span.compare_exchange_weak(span, Span(begin + take, end))) {
+                first = begin;
+                last = begin + take;
+                return true;
             }
-    }*/
+        }
 
-    has_init_processed = true;
-}
+        sweepWorker * victim = nullptr;
+        uint64_t victim_span = 0, most = 0;
 
-bool can_process(double lat, double lon) {
-    /* Lines, text, markings, and coverage areas are stored in a
-    mask that is combined with topology data when topographic
-    maps are generated by ss.  This function sets bits in
-    the mask based on the latitude and longitude of the area
-    pointed to. */
+        for (auto & other : w.sweep->workers) {
+            uint64_t other_span = other.span.load(std::memory_order_acquire);
+            uint64_t left = (other_span >> 32) - (uint32_t)other_span;
 
-    int x, y, indx;
-    char found;
-    bool rtn = false;
+            if ((uint32_t)other_span < (other_span >> 32) && left > most) {
+                victim = &other;
+                victim_span = other_span;
+                most = left;
+            }
+        }
 
-    return true; // XXX hacked for now because we don't use threads
+        if (!victim) {
+            return false;
+        }
 
-    for (indx = 0, found = 0; indx < MAXPAGES && found == 0;) {
-        x = (int)rint(G_ppd * (lat - G_dem[indx]->min_north));
-        y = G_mpi - (int)rint(G_yppd * (LonDiff(G_dem[indx]->max_west, lon)));
+        uint64_t begin = (uint32_t)victim_span, end = victim_span >> 32;
+        uint64_t keep = begin + ((end - begin) / 2);
 
-        if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-            found = 1;
-        } else {
-            indx++;
+        if (victim->span.compare_exchange_strong(victim_span,
+                                                 Span(begin, keep))) {
+            w.span.store(Span(keep, end), std::memory_order_release);
         }
     }
+}
 
-    if (found) {
-        /* As long as we only set this without resetting it we can
-        check outside a mutex first without worrying about race
-        conditions. But we must lock the mutex before updating the
-        value. */
+/* Sweeps the radials worker w claims until none are left. */
+void * SweepRadials(void * parameters) {
+    sweepWorker * w = (sweepWorker *)parameters;
+    propagationSweep const & v = *w->sweep;
+    size_t first, last, next = 0;
+
+    /* Neighbouring radials run along nearly the same terrain.  With
+       azimuth bins, one path down the middle of each bin stands for
+       every radial in it.  Radials along an edge turn steadily, so
+       those sharing a bin come one after another. */
+    int bins = AzimuthBins(v.lr, v.source), last_bin = -1;
+
+    G_path_faults = {};
+    G_reach = w->reach;
+    G_overview_dev = {};
+    G_claims = w->sweep->claims.data();
+    G_crossed = 0;
+    G_claimed = 0;
+    G_forgone = 0;
+    G_path_buffers.reserve(v.samples);
+
+    while (ClaimRadials(*w, first, last)) {
+        /* The path traced last is only for the radial before these
+           if this worker swept it. */
+        if (first != next) {
+            last_bin = -1;
+        }
 
-        if (!processed[indx][x][y]) {
-            pthread_mutex_lock(&maskMutex);
+        for (size_t i = first; i < last; i++) {
+            site edge;
+            edge.lat = v.edges[i].first;
+            edge.lon = v.edges[i].second;
+            edge.alt = v.altitude;
 
-            if (!processed[indx][x][y]) {
-                rtn = true;
-                processed[indx][x][y] = true;
+            w->radials++;
+
+            bool shared = false;
+
+            if (bins > 0) {
+                int bin = (int)(Azimuth(v.source, edge) * bins / 360.0) % bins;
+
+                shared = bin == last_bin;
+
+                if (!shared) {
+                    edge = BinTarget(v.source, edge, bin, bins);
+                    last_bin = bin;
+                }
             }
 
-            pthread_mutex_unlock(&maskMutex);
+            if (shared) {
+                w->shared_samples += G_path_buffers.path.size();
+            } else {
+                G_radial = (uint32_t)i;
+
+                if (v.los) {
+                    PlotLOSPath(v.out, v.source, edge, v.mask_value, v.lr);
+                } else {
+                    PlotPropPath(v.out,
+                                 v.source,
+                                 edge,
+                                 v.mask_value,
+                                 v.fd,
+                                 v.propmodel,
+                                 v.knifeedge,
+                                 v.pmenv,
+                                 v.lr);
+                }
+
+                w->paths++;
+                w->samples += G_path_buffers.path.size();
+            }
         }
+
+        next = last;
     }
-    return rtn;
+
+    w->faults = G_path_faults;
+    w->reach = G_reach;
+    w->deviation = G_overview_dev;
+    w->crossed = G_crossed;
+    w->claimed = G_claimed;
+    w->forgone = G_forgone;
+    G_claims = nullptr;
+
+    return NULL;
 }
 
-void beginThread(void * arg) {
-    if (!has_init_processed) {
-        init_processed();
+/* Sweeps radials to every edge point of sweep on threads workers, or
+   one per hardware thread if threads is 0.  Each starts on an equal
+   run of the edge and, once through it, helps whoever has most left,
+   so that no worker idles while another still has the long diagonal
+   radials to do.  A single worker sweeps the edge in order on the
+   calling thread.  Workers only touch the output through atomic
+   updates of pixels allocated before they start, and what each
+   counts is added to the output once they are all done.  Propagation
+   sweeps leave their pixels in claims, written out at the end, so
+   the plot is the same on any number of threads.  Sweeps writing an
+   .ano file, which lists pixels as they are analysed, and sweeps too
+   long to claim pixels for, are swept in order. */
+void RunSweep(propagationSweep & sweep, int threads) {
+    struct output * out = sweep.out;
+    size_t count = sweep.edges.size();
+    size_t n = threads > 0 ? threads : std::thread::hardware_concurrency();
+    bool claim = !sweep.los && count < CLAIM_RADIALS;
+
+    if ((!sweep.los && !claim) || sweep.fd != NULL) {
+        n = 1;
     }
 
-    int rc = pthread_create(&threads[thread_count], NULL, rangePropagation, arg);
-    if (rc) {
-        fprintf(stderr, "ERROR; return code from pthread_create() is %d\n", rc);
-    } else {
-        ++thread_count;
+    n = std::max(std::min(n, (count + SWEEP_CHUNK - 1) / SWEEP_CHUNK),
+                 (size_t)1);
+    sweep.workers = std::vector<sweepWorker>(n);
+
+    for (size_t i = 0; i < n; i++) {
+        sweep.workers[i].sweep = &sweep;
+        sweep.workers[i].span.store(Span(count * i / n, count * (i + 1) / n));
+        sweep.workers[i].reach = {out->cropLat, out->cropLon, out->hottest};
     }
-}
 
-void finishThreads() {
-    void * status;
-    for (unsigned int i = 0; i < thread_count; i++) {
-        int rc = pthread_join(threads[i], &status);
+    coverage_fit(out);
+
+    if (claim) {
+        long pixels = out->coverage.rows * out->coverage.cols;
+
+        sweep.claims = std::vector<std::atomic<uint32_t>>(pixels);
+
+        for (auto & c : sweep.claims) {
+            c.store(CLAIM_NONE, std::memory_order_relaxed);
+        }
+    }
+
+    /* Workers that can't be started leave their radials to be
+       stolen by the others. */
+    std::vector<pthread_t> pool;
+    pool.reserve(n - 1);
+
+    for (size_t i = 1; i < n; i++) {
+        pthread_t thread;
+        int rc = pthread_create(&thread, NULL, SweepRadials, &sweep.workers[i]);
+
+        if (rc) {
+            fprintf(stderr,
+                    "ERROR; return code from pthread_create() is %d\n",
+                    rc);
+        } else {
+            pool.push_back(thread);
+        }
+    }
+
+    SweepRadials(&sweep.workers[0]);
+
+    for (pthread_t thread : pool) {
+        int rc = pthread_join(thread, NULL);
+
         if (rc) {
             fprintf(stderr, "ERROR; return code from pthread_join() is %d\n", rc);
         }
     }
-    thread_count = 0;
+
+    for (auto const & w : sweep.workers) {
+        out->dem_faults.minor += w.faults.minor;
+        out->dem_faults.major += w.faults.major;
+        out->cropLat = MAX(out->cropLat, w.reach.crop_lat);
+        out->cropLon = MAX(out->cropLon, w.reach.crop_lon);
+        out->hottest = MAX(out->hottest, w.reach.hottest);
+    }
+
+    /* As LeaveSignal() would have, had each pixel's first radial
+       been the only one to cross it */
+    for (size_t pixel = 0; pixel < sweep.claims.size(); pixel++) {
+        uint32_t c = sweep.claims[pixel].load(std::memory_order_relaxed);
+
+        if (c == CLAIM_NONE) {
+            continue;
+        }
+
+        unsigned char value = c & 0xff;
+        unsigned char old =
+            out->coverage.signal[pixel].load(std::memory_order_relaxed);
+
+        if (sweep.lr->erp == 0.0) {
+            value = (old == 0 || old > value) ? value : old;
+        } else {
+            value = MAX(old, value);
+        }
+
+        out->coverage.signal[pixel].store(value, std::memory_order_relaxed);
+        out->coverage.mask[pixel].store(
+            (out->coverage.mask[pixel].load(std::memory_order_relaxed) & ~248)
+                | (sweep.mask_value << 3),
+            std::memory_order_relaxed);
+        out->hottest = MAX(out->hottest, value);
+    }
+}
+
+/* Path loss from the terrain profile models (ITM and ITWOM) over a
+   profile laid out the way their point_to_point() functions take.
+   Given radial, ITM takes elev to be the profile radial was last
+   given taken further out. */
+template <typename P>
+double ProfileLoss(int propmodel,
+                   site const & source,
+                   site const & destination,
+                   P const & elev,
+                   LR const * lr,
+                   itm_radial * radial) {
+    char strmode[100];
+    int errnum;
+    double loss;
+
+    if (propmodel == 8) {
+        point_to_point(source.alt * METERS_PER_FOOT,
+                       destination.alt * METERS_PER_FOOT,
+                       lr->eps_dielect,
+                       lr->sgm_conductivity,
+                       lr->eno_ns_surfref,
+                       lr->frq_mhz,
+                       lr->radio_climate,
+                       lr->pol,
+                       lr->conf,
+                       lr->rel,
+                       loss,
+                       strmode,
+                       elev,
+                       errnum);
+    } else if (radial != NULL) {
+        radial->point_to_point_ITM(source.alt * METERS_PER_FOOT,
+                                   destination.alt * METERS_PER_FOOT,
+                                   lr->eps_dielect,
+                                   lr->sgm_conductivity,
+                                   lr->eno_ns_surfref,
+                                   lr->frq_mhz,
+                                   lr->radio_climate,
+                                   lr->pol,
+                                   lr->conf,
+                                   lr->rel,
+                                   loss,
+                                   strmode,
+                                   elev,
+                                   errnum);
+    } else {
+        point_to_point_ITM(source.alt * METERS_PER_FOOT,
+                           destination.alt * METERS_PER_FOOT,
+                           lr->eps_dielect,
+                           lr->sgm_conductivity,
+                           lr->eno_ns_surfref,
+                           lr->frq_mhz,
+                           lr->radio_climate,
+                           lr->pol,
+                           lr->conf,
+                           lr->rel,
+                           loss,
+                           strmode,
+                           elev,
+                           errnum);
+    }
+
+    return loss;
+}
+
+/* Fills heights from 2 on with the height of each sample of path in
+   metres, the way the terrain models' profiles hold them: clutter is
+   added to all but the end points.  heights is a double profile, or
+   the heights of a float_profile. */
+template <typename T>
+void PathHeights(Path const & path, double clutter, std::vector<T> & heights) {
+    heights.resize(path.size() + 2);
+
+    for (long x = 1; x < path.ssize() - 1; x++) {
+        heights[x + 2] =
+            (path.elevation[x] == 0.0
+                 ? path.elevation[x] * METERS_PER_FOOT
+                 : (clutter + path.elevation[x]) * METERS_PER_FOOT);
+    }
+
+    /* Copy ending points without clutter */
+
+    heights[2] = path.elevation[0] * METERS_PER_FOOT;
+
+    heights[path.ssize() + 1] =
+        path.elevation[path.ssize() - 1] * METERS_PER_FOOT;
+}
+
+/* Builds the profile that heights holds for points 0 to last of path,
+   step metres apart, but spaced 2^level points apart and sampled from
+   that overview level.  overview caches the path's overview elevations
+   between calls.  The end points keep their full resolution heights.
+   Returns the new spacing, which a float profile keeps in double. */
+template <typename T>
+double OverviewProfile(Path const & path,
+                       struct dem_snapshot const & tiles,
+                       int level,
+                       int last,
+                       double step,
+                       T const * heights,
+                       double clutter,
+                       std::vector<double> & overview,
+                       std::vector<T> & profile) {
+    int n = last >> level;
+
+    for (size_t i = overview.size(); i <= (size_t)last; i++) {
+        overview.push_back(
+            dem_overview_elevation(tiles, path.lat[i], path.lon[i], level));
+    }
+
+    profile.resize(n + 3);
+    profile[0] = n;
+    profile[1] = step * last / n;
+    profile[2] = heights[2];
+
+    for (int i = 1; i < n; i++) {
+        double h = overview[((long)i * last + (n / 2)) / n];
+
+        profile[i + 2] = (h == 0.0 ? h : clutter + h) * METERS_PER_FOOT;
+    }
+
+    profile[n + 2] = heights[last + 2];
+
+    return step * last / n;
+}
+
+/* Whether terrain rising to t feet from the earth's centre, at d_lo to
+   d_hi feet from an observer r feet from the centre, could meet or top
+   the sight line whose elevation angle has cosine c.  That is, whether
+   (r^2 + d^2 - t^2) / (2 r d) <= c for some such d, with some slack
+   for rounding since a false answer means those points go untested. */
+bool MayBlock(double r, double c, double t, double d_lo, double d_hi) {
+    if (!(d_lo > 0.0) || c != c) {
+        return true;
+    }
+
+    double d = std::min(std::max(r * c, d_lo), d_hi);
+
+    return t * t >= (r * r) + (d * d) - (2.0 * r * d * c) - (1e-9 * r * r);
+}
+
+void RecordOverviewDeviation(double db) {
+    G_overview_dev.points++;
+    G_overview_dev.sum += fabs(db);
+    G_overview_dev.sum2 += db * db;
+    G_overview_dev.max = MAX(G_overview_dev.max, fabs(db));
 }
 } // namespace
 
@@ -253,7 +836,7 @@ void PlotLOSPath(output * out,
     double cos_angle, cos_test_angle, cos_horizon_angle, cos_limit_angle, rx_alt2;
     double distance, rx_alt, tx_alt, limit_alt, distance2, tx_alt2, test_alt,
         test_alt2, limit_alt2;
-    Path path(source, destination);
+    Path const & path = TracePath(source, destination).path;
 
     distance = 0.0;
     tx_alt = 0.0;
@@ -319,9 +902,8 @@ void PlotLOSPath(output * out,
            Mark this point only if it hasn't been already marked */
 
         if ((cos_horizon_angle >= cos_angle)
-            && ((GetMask(out, path.lat[x], path.lon[x]) & mask_value) == 0)
-            && (can_process(path.lat[x], path.lon[x]))) {
-            OrMask(out, path.lat[x], path.lon[x], mask_value);
+            && ((GetMask(out, path.lat[x], path.lon[x]) & mask_value) == 0)) {
+            UpdateMask(out, path.lat[x], path.lon[x], 0, mask_value);
         }
 
         if (cos_test_angle < cos_horizon_angle) {
@@ -367,31 +949,41 @@ void PlotPropPath(struct output * out,
                   int knifeedge,
                   int pmenv,
                   LR const * lr) {
-    Path path(source, destination);
-    int x, y, ifs, ofs, errnum;
-    char block = 0, strmode[100];
-    double loss, azimuth,
-        pattern = 0.0, xmtr_alt, dest_alt, xmtr_alt2, dest_alt2, cos_rcvr_angle,
-        cos_test_angle = 0.0, test_alt, elevation = 0.0, distance = 0.0,
-        four_thirds_earth, field_strength = 0.0, rxp, dBm, diffloss;
+    PathBuffers & buffers = TracePath(source, destination);
+    Path & path = buffers.path;
+    PathSight & sight = buffers.sight;
+    std::vector<double> & elev = buffers.elev;
+    int x, y, ifs, level;
+    bool block = false;
+    double loss, azimuth, pattern = 0.0, elevation = 0.0, four_thirds_earth,
+        field_strength = 0.0, rxp, dBm, diffloss, points, step;
     struct site temp;
     float dkm;
+    double * profile;
+    float_profile compact = {};
+    bool coarse;
+    bool full = !lr->compact_profile || knifeedge == 1 || lr->overview_check;
+    auto tiles = dem_cache_snapshot();
+
+    for (level = 1; level <= DEM_OVERVIEW_LEVELS; level++) {
+        buffers.overview[level].clear();
+    }
 
+    buffers.itm.start();
     four_thirds_earth = FOUR_THIRDS * EARTHRADIUS_FT;
-
-    for (x = 1; x < path.ssize() - 1; x++) {
-        out->elev[x + 2] =
-            (path.elevation[x] == 0.0
-                 ? path.elevation[x] * METERS_PER_FOOT
-                 : (lr->clutter + path.elevation[x]) * METERS_PER_FOOT);
+    sight.start(four_thirds_earth + source.alt + path.elevation[0],
+                four_thirds_earth,
+                lr->clutter);
+
+    /* The profile the terrain models are given: two header
+       values, then the height of every sample. */
+    if (full) {
+        PathHeights(path, lr->clutter, elev);
     }
 
-    /* Copy ending points without clutter */
-
-    out->elev[2] = path.elevation[0] * METERS_PER_FOOT;
-
-    out->elev[path.ssize() + 1] =
-        path.elevation[path.ssize() - 1] * METERS_PER_FOOT;
+    if (lr->compact_profile) {
+        PathHeights(path, lr->clutter, buffers.compact);
+    }
 
     /* Since the only energy the Longley-Rice model considers
        reaching the destination is based on what is scattered
@@ -406,117 +998,116 @@ void PlotPropPath(struct output * out,
     //	fprintf(stderr,"four_thirds_earth %.1f source.alt %.1f path.elevation[0]
     //%.1f\n",four_thirds_earth,source.alt,path.elevation[0]);
     for (y = 2; (y < (path.ssize() - 1) && path.distance[y] <= lr->max_range); y++) {
-        /* Process this point only if it
-           has not already been processed. */
+        /* Process this point only if it has not already been
+           processed, by this radial or in a sweep by one before it. */
+
+        G_crossed++;
 
         if ((GetMask(out, path.lat[y], path.lon[y]) & 248) != (mask_value << 3)
-            && can_process(path.lat[y], path.lon[y])) {
+            && ClaimPixel(out, path.lat[y], path.lon[y])) {
             char fd_buffer[64];
             int buffer_offset = 0;
 
-            distance = FEET_PER_MILE * path.distance[y];
-            xmtr_alt = four_thirds_earth + source.alt + path.elevation[0];
-            dest_alt = four_thirds_earth + destination.alt + path.elevation[y];
-            dest_alt2 = dest_alt * dest_alt;
-            xmtr_alt2 = xmtr_alt * xmtr_alt;
-
-            /* Calculate the cosine of the elevation of
-               the receiver as seen by the transmitter. */
-
-            cos_rcvr_angle = ((xmtr_alt2) + (distance * distance) - (dest_alt2))
-                             / (2.0 * xmtr_alt * distance);
-
-            if (cos_rcvr_angle > 1.0) {
-                cos_rcvr_angle = 1.0;
-            }
-
-            if (cos_rcvr_angle < -1.0) {
-                cos_rcvr_angle = -1.0;
-            }
-
-            if (G_got_elevation_pattern || fd != NULL) {
+            if (lr->got_elevation_pattern || fd != NULL) {
                 /* Determine the elevation angle to the first obstruction
                    along the path IF elevation pattern data is available
-                   or an output (.ano) file has been designated. */
-
-                for (x = 2, block = 0; (x < y && block == 0); x++) {
-                    distance = FEET_PER_MILE * path.distance[x];
-
-                    test_alt = four_thirds_earth
-                               + (path.elevation[x] == 0.0
-                                      ? path.elevation[x]
-                                      : path.elevation[x] + lr->clutter);
-
-                    /* Calculate the cosine of the elevation
-                       angle of the terrain (test point)
-                       as seen by the transmitter. */
-
-                    cos_test_angle = ((xmtr_alt2) + (distance * distance)
-                                      - (test_alt * test_alt))
-                                     / (2.0 * xmtr_alt * distance);
-
-                    if (cos_test_angle > 1.0) {
-                        cos_test_angle = 1.0;
-                    }
-
-                    if (cos_test_angle < -1.0) {
-                        cos_test_angle = -1.0;
-                    }
-
-                    /* Compare these two angles to determine if
-                       an obstruction exists.  Since we're comparing
-                       the cosines of these angles rather than
-                       the angles themselves, the sense of the
-                       following "if" statement is reversed from
-                       what it would be if the angles themselves
-                       were compared. */
-
-                    if (cos_rcvr_angle >= cos_test_angle) {
-                        block = 1;
-                    }
-                }
-
-                if (block) {
-                    elevation = ((acos(cos_test_angle)) / DEG2RAD) - 90.0;
-                } else {
-                    elevation = ((acos(cos_rcvr_angle)) / DEG2RAD) - 90.0;
-                }
+                   or an output (.ano) file has been designated.  That is
+                   the angle at which the transmitter sees this point, or
+                   if the terrain before it rises into that sight line,
+                   the angle of the nearest sample that does. */
+
+                elevation = sight.elevation(
+                    path,
+                    y,
+                    four_thirds_earth + destination.alt + path.elevation[y],
+                    block);
             }
 
             /* Determine attenuation for each point along the
                path using a prop model starting at y=2 (number_of_points = 1),
                the shortest distance terrain can play a role in path loss. */
 
-            out->elev[0] = y - 1; /* (number of points - 1) */
+            points = y - 1; /* (number of points - 1) */
 
             /* Distance between elevation samples */
 
-            out->elev[1] =
-                METERS_PER_MILE * (path.distance[y] - path.distance[y - 1]);
+            step = METERS_PER_MILE * (path.distance[y] - path.distance[y - 1]);
+
+            if (full) {
+                elev[0] = points;
+                elev[1] = step;
+            }
 
             if (path.elevation[y] < 1) {
                 path.elevation[y] = 1;
             }
 
-            dkm = (out->elev[1] * out->elev[0]) / 1000; // km
+            dkm = (step * points) / 1000; // km
+
+            /* Far enough out, ITM gets a profile sampled from a
+               coarser overview of the terrain.  ITWOM doesn't: over
+               coarse profiles -ovrchk puts it several times further
+               from its full resolution losses than ITM. */
+
+            profile = elev.data();
+            level = propmodel == 1 ? dem_overview_level(path.distance[y],
+                                                        lr->overview_range)
+                                   : 0;
+            coarse = level > 0 && ((y - 1) >> level) >= 2;
+
+            if (lr->compact_profile) {
+                compact.points = points;
+                compact.step = step;
+                compact.pfl = buffers.compact.data();
+
+                if (coarse) {
+                    compact.points = (y - 1) >> level;
+                    compact.step = OverviewProfile(path,
+                                                   *tiles,
+                                                   level,
+                                                   y - 1,
+                                                   step,
+                                                   compact.pfl,
+                                                   lr->clutter,
+                                                   buffers.overview[level],
+                                                   buffers.compact_coarse);
+                    compact.pfl = buffers.compact_coarse.data();
+                }
+            } else if (coarse) {
+                OverviewProfile(path,
+                                *tiles,
+                                level,
+                                y - 1,
+                                step,
+                                profile,
+                                lr->clutter,
+                                buffers.overview[level],
+                                buffers.coarse);
+                profile = buffers.coarse.data();
+            }
+
+            itm_radial * radial = NULL;
+
+            auto terrain_loss = [&]() {
+                /* Full resolution profiles only ever grow along the
+                   radial, so ITM carries them from point to point. */
+                if (!coarse && propmodel != 8) {
+                    radial = &buffers.itm;
+                }
+
+                if (lr->compact_profile) {
+                    return ProfileLoss(
+                        propmodel, source, destination, compact, lr, radial);
+                }
+
+                return ProfileLoss(
+                    propmodel, source, destination, profile, lr, radial);
+            };
 
             switch (propmodel) {
             case 1:
                 // Longley Rice ITM
-                point_to_point_ITM(source.alt * METERS_PER_FOOT,
-                                   destination.alt * METERS_PER_FOOT,
-                                   lr->eps_dielect,
-                                   lr->sgm_conductivity,
-                                   lr->eno_ns_surfref,
-                                   lr->frq_mhz,
-                                   lr->radio_climate,
-                                   lr->pol,
-                                   lr->conf,
-                                   lr->rel,
-                                   loss,
-                                   strmode,
-                                   out->elev.data(),
-                                   errnum);
+                loss = terrain_loss();
                 break;
             case 3:
                 // HATA 1, 2 & 3
@@ -560,20 +1151,7 @@ void PlotPropPath(struct output * out,
                 break;
             case 8:
                 // ITWOM 3.0
-                point_to_point(source.alt * METERS_PER_FOOT,
-                               destination.alt * METERS_PER_FOOT,
-                               lr->eps_dielect,
-                               lr->sgm_conductivity,
-                               lr->eno_ns_surfref,
-                               lr->frq_mhz,
-                               lr->radio_climate,
-                               lr->pol,
-                               lr->conf,
-                               lr->rel,
-                               loss,
-                               strmode,
-                               out->elev.data(),
-                               errnum);
+                loss = terrain_loss();
                 break;
             case 9:
                 // Ericsson
@@ -605,27 +1183,25 @@ void PlotPropPath(struct output * out,
                 break;
 
             default:
-                point_to_point_ITM(source.alt * METERS_PER_FOOT,
-                                   destination.alt * METERS_PER_FOOT,
-                                   lr->eps_dielect,
-                                   lr->sgm_conductivity,
-                                   lr->eno_ns_surfref,
-                                   lr->frq_mhz,
-                                   lr->radio_climate,
-                                   lr->pol,
-                                   lr->conf,
-                                   lr->rel,
-                                   loss,
-                                   strmode,
-                                   out->elev.data(),
-                                   errnum);
+                loss = terrain_loss();
+            }
+
+            if (lr->overview_check
+                && (coarse || lr->compact_profile || radial != NULL)) {
+                RecordOverviewDeviation(loss
+                                        - ProfileLoss(propmodel,
+                                                      source,
+                                                      destination,
+                                                      elev.data(),
+                                                      lr,
+                                                      NULL));
             }
 
             if (knifeedge == 1 && propmodel > 1) {
                 diffloss = ked(lr->frq_mhz,
                                destination.alt * METERS_PER_FOOT,
                                dkm,
-                               out->elev.data());
+                               elev.data());
                 loss += (diffloss); // ;)
             }
             // Key stage. Link dB for p2p is returned as 'loss'.
@@ -700,13 +1276,6 @@ void PlotPropPath(struct output * out,
                         ifs = 255;
                     }
 
-                    ofs = GetSignal(out, path.lat[y], path.lon[y]);
-
-                    if (ofs > ifs) {
-                        ifs = ofs;
-                    }
-
-                    PutSignal(out, path.lat[y], path.lon[y], (unsigned char)ifs);
                 }
 
                 else {
@@ -723,14 +1292,6 @@ void PlotPropPath(struct output * out,
                         ifs = 255;
                     }
 
-                    ofs = GetSignal(out, path.lat[y], path.lon[y]);
-
-                    if (ofs > ifs) {
-                        ifs = ofs;
-                    }
-
-                    PutSignal(out, path.lat[y], path.lon[y], (unsigned char)ifs);
-
                     if (fd != NULL) {
                         buffer_offset += snprintf(fd_buffer + buffer_offset,
                                                   sizeof(fd_buffer) - buffer_offset,
@@ -746,15 +1307,16 @@ void PlotPropPath(struct output * out,
                 } else {
                     ifs = (int)rint(loss);
                 }
+            }
 
-                ofs = GetSignal(out, path.lat[y], path.lon[y]);
-
-                if (ofs < ifs && ofs != 0) {
-                    ifs = ofs;
-                }
+            /* Mark this point as having been analyzed */
 
-                PutSignal(out, path.lat[y], path.lon[y], (unsigned char)ifs);
-            }
+            LeaveSignal(out,
+                        path.lat[y],
+                        path.lon[y],
+                        (unsigned char)ifs,
+                        lr->erp == 0.0,
+                        mask_value);
 
             if (fd != NULL) {
                 if (block) {
@@ -764,23 +1326,21 @@ void PlotPropPath(struct output * out,
                 }
                 fprintf(fd, "%s\n", fd_buffer);
             }
+        }
 
-            /* Mark this point as having been analyzed */
-
-            PutMask(out,
-                    path.lat[y],
-                    path.lon[y],
-                    (GetMask(out, path.lat[y], path.lon[y]) & 7)
-                        + (mask_value << 3));
+        /* Whether or not this radial analysed it, the sample is seen
+           from further out as it would be had it been. */
+        if (path.elevation[y] < 1) {
+            path.elevation[y] = 1;
         }
     }
 
-    if (path.lat[y] > out->cropLat) {
-        out->cropLat = path.lat[y];
+    if (path.lat[y] > G_reach.crop_lat) {
+        G_reach.crop_lat = path.lat[y];
     }
 
-    if (y > out->cropLon) {
-        out->cropLon = y;
+    if (y > G_reach.crop_lon) {
+        G_reach.crop_lon = y;
     }
 
     // if(cropLon>180)
@@ -791,7 +1351,7 @@ void PlotLOSMap(struct output * out,
                 struct site source,
                 double altitude,
                 char * plo_filename,
-                bool use_threads,
+                int threads,
                 LR const * lr) {
     /* This function performs a 360 degree sweep around the
        transmitter site (source location), and plots the
@@ -819,63 +1379,19 @@ void PlotLOSMap(struct output * out,
                 out->min_north);
     }
 
-    // Four sections start here
-    // Process north edge east/west, east edge north/south,
-    // south edge east/west, west edge north/south
-    double range_min_west[] = {out->min_west,
-                               out->min_west,
-                               out->min_west,
-                               out->max_west};
-    double range_min_north[] = {out->max_north,
-                                out->min_north,
-                                out->min_north,
-                                out->min_north};
-    double range_max_west[] = {out->max_west,
-                               out->min_west,
-                               out->max_west,
-                               out->max_west};
-    double range_max_north[] = {out->max_north,
-                                out->max_north,
-                                out->min_north,
-                                out->max_north};
-    propagationRange * r[NUM_SECTIONS];
-
-    for (int i = 0; i < NUM_SECTIONS; ++i) {
-        propagationRange * range = new propagationRange;
-        r[i] = range;
-        range->los = true;
-
-        range->eastwest = (range_min_west[i] == range_max_west[i] ? false : true);
-        range->min_west = range_min_west[i];
-        range->max_west = range_max_west[i];
-        range->min_north = range_min_north[i];
-        range->max_north = range_max_north[i];
-
-        range->use_threads = use_threads;
-        range->altitude = altitude;
-        range->source = source;
-        range->mask_value = mask_value;
-        range->fd = fd;
-        range->out = out;
-        range->lr = lr;
-
-        if (use_threads) {
-            beginThread(range);
-        } else {
-            if (!has_init_processed) {
-                init_processed();
-            }
-            rangePropagation(range);
-        }
-    }
+    propagationSweep sweep = {};
+    sweep.los = true;
+    sweep.altitude = altitude;
+    sweep.source = source;
+    sweep.mask_value = mask_value;
+    sweep.fd = fd;
+    sweep.out = out;
+    sweep.lr = lr;
 
-    if (use_threads) {
-        finishThreads();
-    }
+    AddEdges(sweep, out, 0);
 
-    for (int i = 0; i < NUM_SECTIONS; ++i) {
-        delete r[i];
-    }
+    RunSweep(sweep, threads);
+    ReportRadials(sweep, AzimuthBins(lr, source));
 
     switch (mask_value) {
     case 1:
@@ -899,7 +1415,7 @@ void PlotPropagation(struct output * out,
                      int knifeedge,
                      int haf,
                      int pmenv,
-                     bool use_threads,
+                     int threads,
                      LR const * lr) {
     static __thread unsigned char mask_value = 1;
     FILE * fd = NULL;
@@ -947,79 +1463,49 @@ void PlotPropagation(struct output * out,
                 out->min_north);
     }
 
-    // Four sections start here
-    // Process north edge east/west, east edge north/south,
-    // south edge east/west, west edge north/south
-    double range_min_west[] = {out->min_west,
-                               out->min_west,
-                               out->min_west,
-                               out->max_west};
-    double range_min_north[] = {out->max_north,
-                                out->min_north,
-                                out->min_north,
-                                out->min_north};
-    double range_max_west[] = {out->max_west,
-                               out->min_west,
-                               out->max_west,
-                               out->max_west};
-    double range_max_north[] = {out->max_north,
-                                out->max_north,
-                                out->min_north,
-                                out->max_north};
-    propagationRange * r[NUM_SECTIONS];
-
-    for (int i = 0; i < NUM_SECTIONS; ++i) {
-        propagationRange * range = new propagationRange;
-        r[i] = range;
-        range->los = false;
-
-        // Only process correct half
-        if ((NUM_SECTIONS - i) <= (NUM_SECTIONS / 2) && haf == 1) {
-            continue;
-        }
-        if ((NUM_SECTIONS - i) > (NUM_SECTIONS / 2) && haf == 2) {
-            continue;
-        }
-
-        range->eastwest = (range_min_west[i] == range_max_west[i] ? false : true);
-        range->min_west = range_min_west[i];
-        range->max_west = range_max_west[i];
-        range->min_north = range_min_north[i];
-        range->max_north = range_max_north[i];
-
-        range->use_threads = use_threads;
-        range->altitude = altitude;
-        range->source = source;
-        range->mask_value = mask_value;
-        range->fd = fd;
-        range->propmodel = propmodel;
-        range->knifeedge = knifeedge;
-        range->pmenv = pmenv;
-        range->out = out;
-        range->lr = lr;
-
-        if (use_threads) {
-            beginThread(range);
-        } else {
-            if (!has_init_processed) {
-                init_processed();
-            }
-            rangePropagation(range);
-        }
-    }
+    propagationSweep sweep = {};
+    sweep.los = false;
+    sweep.altitude = altitude;
+    sweep.source = source;
+    sweep.mask_value = mask_value;
+    sweep.fd = fd;
+    sweep.propmodel = propmodel;
+    sweep.knifeedge = knifeedge;
+    sweep.pmenv = pmenv;
+    sweep.out = out;
+    sweep.lr = lr;
 
-    if (use_threads) {
-        finishThreads();
-    }
+    AddEdges(sweep, out, haf);
 
-    for (int i = 0; i < NUM_SECTIONS; ++i) {
-        delete r[i];
-    }
+    RunSweep(sweep, threads);
+    ReportRadials(sweep, AzimuthBins(lr, source));
 
     if (fd != NULL) {
         fclose(fd);
     }
 
+    if (lr->overview_check) {
+        struct overviewDeviation dev = {};
+
+        for (auto const & w : sweep.workers) {
+            dev.points += w.deviation.points;
+            dev.sum += w.deviation.sum;
+            dev.sum2 += w.deviation.sum2;
+            dev.max = MAX(dev.max, w.deviation.max);
+        }
+
+        unsigned long points = MAX(dev.points, 1UL);
+
+        fprintf(stderr,
+                "Profile deviation over %lu points: mean %.2f dB, "
+                "rms %.2f dB, max %.2f dB\n",
+                dev.points,
+                dev.sum / points,
+                sqrt(dev.sum2 / points),
+                dev.max);
+        fflush(stderr);
+    }
+
     if (mask_value < 30) {
         mask_value++;
     }
@@ -1041,9 +1527,10 @@ void PlotPath(Path const & path,
        maps are later generated by SPLAT!. */
 
     char block;
-    int x, y;
+    int y;
     double cos_xmtr_angle, cos_test_angle, test_alt;
     double distance, rx_alt, tx_alt;
+    PathPeaks peaks(path);
 
     for (y = 0; y < path.ssize(); y++) {
         /* Test this point only if it hasn't been already
@@ -1061,7 +1548,20 @@ void PlotPath(Path const & path,
                 ((rx_alt * rx_alt) + (distance * distance) - (tx_alt * tx_alt))
                 / (2.0 * rx_alt * distance);
 
-            for (x = y, block = 0; x >= 0 && block == 0; x--) {
+            /* Any obstruction will do, so the path back to the
+               transmitter is searched in whichever order lets peaks
+               pass over the stretches too low to matter. */
+
+            auto may_block = [&](ssize_t first, ssize_t last, double peak) {
+                return MayBlock(
+                    rx_alt,
+                    cos_xmtr_angle,
+                    EARTHRADIUS_FT + MAX(peak + lr->clutter, 0.0),
+                    FEET_PER_MILE * (path.distance[y] - path.distance[last]),
+                    FEET_PER_MILE * (path.distance[y] - path.distance[first]));
+            };
+
+            auto blocks = [&](ssize_t x) {
                 distance = FEET_PER_MILE * (path.distance[y] - path.distance[x]);
                 test_alt = EARTHRADIUS_FT
                            + (path.elevation[x] == 0.0
@@ -1075,14 +1575,14 @@ void PlotPath(Path const & path,
                 /* Compare these two angles to determine if
                    an obstruction exists.  Since we're comparing
                    the cosines of these angles rather than
-                   the angles themselves, the following "if"
-                   statement is reversed from what it would
-                   be if the actual angles were compared. */
+                   the angles themselves, the following comparison
+                   is reversed from what it would be if the actual
+                   angles were compared. */
 
-                if (cos_xmtr_angle >= cos_test_angle) {
-                    block = 1;
-                }
-            }
+                return cos_xmtr_angle >= cos_test_angle;
+            };
+
+            block = peaks.find(0, y + 1, may_block, blocks) <= y;
 
             if (block == 0) {
                 OrMask(out, path.lat[y], path.lon[y], mask_value);
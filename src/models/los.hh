@@ -23,7 +23,7 @@ void PlotLOSMap(struct output * out,
                 struct site source,
                 double altitude,
                 char * plo_filename,
-                bool use_threads,
+                int threads,
                 LR const * lr);
 void PlotPropagation(struct output * out,
                      struct site source,
@@ -33,7 +33,7 @@ void PlotPropagation(struct output * out,
                      int knifeedge,
                      int haf,
                      int pmenv,
-                     bool use_threads,
+                     int threads,
                      LR const * lr);
 void PlotPath(Path const & path,
               struct output * out,
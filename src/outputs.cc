@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "common.hh"
+#include "coverage.hh"
 #include "image.hh"
 #include "inputs.hh"
 #include "models/cost.hh"
@@ -35,9 +36,11 @@ void DoPathLoss(struct output * out,
 
     unsigned red, green, blue, terrain = 0;
     unsigned char mask, cityorcounty;
-    struct dem_output * found;
+    const struct dem * found;
+    std::vector<long> cols;
+    long row, pixel = 0;
     int x, y, z, x0 = 0, y0 = 0, loss, match;
-    double lat, lon, conversion, one_over_gamma, minwest;
+    double lat, conversion, one_over_gamma, minwest;
     image_ctx_t ctx;
     int success;
 
@@ -88,29 +91,22 @@ void DoPathLoss(struct output * out,
         fflush(stderr);
     }
 
+    cols = coverage_cols(out->coverage, out->max_west, out->width);
+
     for (y = 0, lat = out->north; y < (int)out->height;
          y++, lat = out->north - (G_dpp * (double)y)) {
-        for (x = 0, lon = out->max_west; x < (int)out->width;
-             x++, lon = out->max_west - (G_dpp * (double)x)) {
-            if (lon < 0.0) {
-                lon += 360.0;
-            }
+        row = coverage_row(out->coverage, lat);
 
+        for (x = 0; x < (int)out->width; x++) {
             found = NULL;
-            // for (std::vector<dem_output>::iterator i = v.begin(); i != v.end() && found == 0; ++i) {
-            for (auto & i : out->dem_out) {
-                x0 = (int)rint(G_ppd * (lat - (double)i.min_north));
-                y0 = G_mpi - (int)rint(G_ppd * (LonDiff((double)i.max_west, lon)));
-
-                if (x0 >= 0 && x0 <= G_mpi && y0 >= 0 && y0 <= G_mpi) {
-                    found = &i;
-                    break;
-                }
-            }
 
+            if (row >= 0 && cols[x] >= 0) {
+                found = coverage_tile(out->coverage, row, cols[x], x0, y0);
+                pixel = row * out->coverage.cols + cols[x];
+            }
             if (found != NULL) {
-                mask = found->mask[DEM_INDEX(found->dem->ippd, x0, y0)];
-                loss = found->signal[DEM_INDEX(found->dem->ippd, x0, y0)];
+                mask = out->coverage.mask[pixel];
+                loss = out->coverage.signal[pixel];
                 cityorcounty = 0;
 
                 match = 255;
@@ -165,14 +161,12 @@ void DoPathLoss(struct output * out,
                         } else {
                             /* Display land or sea elevation */
 
-                            if (found->dem->data[DEM_INDEX(found->dem->ippd, x0, y0)]
-                                == 0) {
+                            if (found->sample(x0, y0) == 0) {
                                 ADD_PIXEL(&ctx, 0, 0, 170);
                             } else {
                                 terrain =
                                     (unsigned)(0.5
-                                               + pow((double)(found->dem->data[DEM_INDEX(
-                                                                  found->dem->ippd, x0, y0)]
+                                               + pow((double)(found->sample(x0, y0)
                                                               - out->min_elevation),
                                                      one_over_gamma)
                                                      * conversion);
@@ -189,15 +183,13 @@ void DoPathLoss(struct output * out,
 
                         } else { /* terrain / sea-level */
 
-                            if (found->dem->data[DEM_INDEX(found->dem->ippd, x0, y0)]
-                                == 0) {
+                            if (found->sample(x0, y0) == 0) {
                                 ADD_PIXEL(&ctx, 0, 0, 170);
                             } else {
                                 /* Elevation: Greyscale */
                                 terrain =
                                     (unsigned)(0.5
-                                               + pow((double)(found->dem->data[DEM_INDEX(
-                                                                  found->dem->ippd, x0, y0)]
+                                               + pow((double)(found->sample(x0, y0)
                                                               - out->min_elevation),
                                                      one_over_gamma)
                                                      * conversion);
@@ -238,9 +230,11 @@ int DoSigStr(struct output * out,
 
     unsigned terrain, red, green, blue;
     unsigned char mask, cityorcounty;
-    struct dem_output * found;
+    const struct dem * found;
+    std::vector<long> cols;
+    long row, pixel = 0;
     int x, y, z = 1, x0 = 0, y0 = 0, signal, match;
-    double conversion, one_over_gamma, lat, lon, minwest;
+    double conversion, one_over_gamma, lat, minwest;
     image_ctx_t ctx;
     int success;
 
@@ -286,28 +280,22 @@ int DoSigStr(struct output * out,
         fflush(stderr);
     }
 
+    cols = coverage_cols(out->coverage, out->max_west, out->width);
+
     for (y = 0, lat = out->north; y < (int)out->height;
          y++, lat = out->north - (G_dpp * (double)y)) {
-        for (x = 0, lon = out->max_west; x < (int)out->width;
-             x++, lon = out->max_west - (G_dpp * (double)x)) {
-            if (lon < 0.0) {
-                lon += 360.0;
-            }
+        row = coverage_row(out->coverage, lat);
 
+        for (x = 0; x < (int)out->width; x++) {
             found = NULL;
-            for (auto & i : out->dem_out) {
-                x0 = (int)rint(G_ppd * (lat - (double)i.min_north));
-                y0 = G_mpi - (int)rint(G_ppd * (LonDiff((double)i.max_west, lon)));
 
-                if (x0 >= 0 && x0 <= G_mpi && y0 >= 0 && y0 <= G_mpi) {
-                    found = &i;
-                    break;
-                }
+            if (row >= 0 && cols[x] >= 0) {
+                found = coverage_tile(out->coverage, row, cols[x], x0, y0);
+                pixel = row * out->coverage.cols + cols[x];
             }
-
             if (found) {
-                mask = found->mask[DEM_INDEX(found->dem->ippd, x0, y0)];
-                signal = (found->signal[DEM_INDEX(found->dem->ippd, x0, y0)]) - 100;
+                mask = out->coverage.mask[pixel];
+                signal = (out->coverage.signal[pixel]) - 100;
                 cityorcounty = 0;
                 match = 255;
 
@@ -359,14 +347,12 @@ int DoSigStr(struct output * out,
                         } else {
                             /* Display land or sea elevation */
 
-                            if (found->dem->data[DEM_INDEX(found->dem->ippd, x0, y0)]
-                                == 0) {
+                            if (found->sample(x0, y0) == 0) {
                                 ADD_PIXEL(&ctx, 0, 0, 170);
                             } else {
                                 terrain =
                                     (unsigned)(0.5
-                                               + pow((double)(found->dem->data[DEM_INDEX(
-                                                                  found->dem->ippd, x0, y0)]
+                                               + pow((double)(found->sample(x0, y0)
                                                               - out->min_elevation),
                                                      one_over_gamma)
                                                      * conversion);
@@ -386,15 +372,13 @@ int DoSigStr(struct output * out,
                             if (ngs) {
                                 ADD_PIXELA(&ctx, 255, 255, 255, 0);
                             } else {
-                                if (found->dem->data[DEM_INDEX(found->dem->ippd, x0, y0)]
-                                    == 0) {
+                                if (found->sample(x0, y0) == 0) {
                                     ADD_PIXEL(&ctx, 0, 0, 170);
                                 } else {
                                     /* Elevation: Greyscale */
                                     terrain =
                                         (unsigned)(0.5
-                                                   + pow((double)(found->dem->data[DEM_INDEX(
-                                                                      found->dem->ippd, x0, y0)]
+                                                   + pow((double)(found->sample(x0, y0)
                                                                   - out->min_elevation),
                                                          one_over_gamma)
                                                          * conversion);
@@ -438,9 +422,11 @@ void DoRxdPwr(struct output * out,
 
     unsigned terrain, red, green, blue;
     unsigned char mask, cityorcounty;
-    struct dem_output * found;
+    const struct dem * found;
+    std::vector<long> cols;
+    long row, pixel = 0;
     int x, y, z = 1, x0 = 0, y0 = 0, dBm, match;
-    double conversion, one_over_gamma, lat, lon, minwest;
+    double conversion, one_over_gamma, lat, minwest;
     image_ctx_t ctx;
     int success;
 
@@ -487,28 +473,22 @@ void DoRxdPwr(struct output * out,
     }
 
     // Draw image of x by y pixels
+    cols = coverage_cols(out->coverage, out->max_west, out->width);
+
     for (y = 0, lat = out->north; y < (int)out->height;
          y++, lat = out->north - (G_dpp * (double)y)) {
-        for (x = 0, lon = out->max_west; x < (int)out->width;
-             x++, lon = out->max_west - (G_dpp * (double)x)) {
-            if (lon < 0.0) {
-                lon += 360.0;
-            }
+        row = coverage_row(out->coverage, lat);
 
+        for (x = 0; x < (int)out->width; x++) {
             found = NULL;
-            for (auto & i : out->dem_out) {
-                x0 = (int)rint((G_ppd * (lat - (double)i.min_north)));
-                y0 = G_mpi - (int)rint(G_ppd * (LonDiff((double)i.max_west, lon)));
 
-                if (x0 >= 0 && x0 <= G_mpi && y0 >= 0 && y0 <= G_mpi) {
-                    found = &i;
-                    break;
-                }
+            if (row >= 0 && cols[x] >= 0) {
+                found = coverage_tile(out->coverage, row, cols[x], x0, y0);
+                pixel = row * out->coverage.cols + cols[x];
             }
-
             if (found) {
-                mask = found->mask[DEM_INDEX(found->dem->ippd, x0, y0)];
-                dBm = (found->signal[DEM_INDEX(found->dem->ippd, x0, y0)]) - 200;
+                mask = out->coverage.mask[pixel];
+                dBm = (out->coverage.signal[pixel]) - 200;
                 cityorcounty = 0;
                 match = 255;
 
@@ -558,14 +538,12 @@ void DoRxdPwr(struct output * out,
                         } else {
                             /* Display land or sea elevation */
 
-                            if (found->dem->data[DEM_INDEX(found->dem->ippd, x0, y0)]
-                                == 0) {
+                            if (found->sample(x0, y0) == 0) {
                                 ADD_PIXEL(&ctx, 0, 0, 170);
                             } else {
                                 terrain =
                                     (unsigned)(0.5
-                                               + pow((double)(found->dem->data[DEM_INDEX(
-                                                                  found->dem->ippd, x0, y0)]
+                                               + pow((double)(found->sample(x0, y0)
                                                               - out->min_elevation),
                                                      one_over_gamma)
                                                      * conversion);
@@ -586,16 +564,14 @@ void DoRxdPwr(struct output * out,
                                 ADD_PIXEL(&ctx, 255, 255,
                                           255); // WHITE
                             } else {
-                                if (found->dem->data[DEM_INDEX(found->dem->ippd, x0, y0)]
-                                    == 0) {
+                                if (found->sample(x0, y0) == 0) {
                                     ADD_PIXEL(&ctx, 0, 0,
                                               170); // BLUE
                                 } else {
                                     /* Elevation: Greyscale */
                                     terrain =
                                         (unsigned)(0.5
-                                                   + pow((double)(found->dem->data[DEM_INDEX(
-                                                                      found->dem->ippd, x0, y0)]
+                                                   + pow((double)(found->sample(x0, y0)
                                                                   - out->min_elevation),
                                                          one_over_gamma)
                                                          * conversion);
@@ -633,9 +609,11 @@ void DoLOS(struct output * out, unsigned char kml, unsigned char ngs, struct sit
 
     unsigned terrain;
     unsigned char mask;
-    struct dem_output * found;
+    const struct dem * found;
+    std::vector<long> cols;
+    long row, pixel = 0;
     int x, y, x0 = 0, y0 = 0;
-    double conversion, one_over_gamma, lat, lon, minwest;
+    double conversion, one_over_gamma, lat, minwest;
     image_ctx_t ctx;
     int success;
 
@@ -676,27 +654,21 @@ void DoLOS(struct output * out, unsigned char kml, unsigned char ngs, struct sit
         fflush(stderr);
     }
 
+    cols = coverage_cols(out->coverage, out->max_west, out->width);
+
     for (y = 0, lat = out->north; y < (int)out->height;
          y++, lat = out->north - (G_dpp * (double)y)) {
-        for (x = 0, lon = out->max_west; x < (int)out->width;
-             x++, lon = out->max_west - (G_dpp * (double)x)) {
-            if (lon < 0.0) {
-                lon += 360.0;
-            }
+        row = coverage_row(out->coverage, lat);
 
+        for (x = 0; x < (int)out->width; x++) {
             found = NULL;
-            for (auto & i : out->dem_out) {
-                x0 = (int)rint(G_ppd * (lat - (double)i.min_north));
-                y0 = G_mpi - (int)rint(G_ppd * (LonDiff((double)i.max_west, lon)));
 
-                if (x0 >= 0 && x0 <= G_mpi && y0 >= 0 && y0 <= G_mpi) {
-                    found = &i;
-                    break;
-                }
+            if (row >= 0 && cols[x] >= 0) {
+                found = coverage_tile(out->coverage, row, cols[x], x0, y0);
+                pixel = row * out->coverage.cols + cols[x];
             }
-
             if (found) {
-                mask = found->mask[DEM_INDEX(found->dem->ippd, x0, y0)];
+                mask = out->coverage.mask[pixel];
 
                 if (mask & 2) { /* Text Labels: Red */
                     ADD_PIXEL(&ctx, 255, 0, 0);
@@ -787,15 +759,13 @@ void DoLOS(struct output * out, unsigned char kml, unsigned char ngs, struct sit
                             ADD_PIXELA(&ctx, 255, 255, 255, 0);
                         } else {
                             /* Sea-level: Medium Blue */
-                            if (found->dem->data[DEM_INDEX(found->dem->ippd, x0, y0)]
-                                == 0) {
+                            if (found->sample(x0, y0) == 0) {
                                 ADD_PIXEL(&ctx, 0, 0, 170);
                             } else {
                                 /* Elevation: Greyscale */
                                 terrain =
                                     (unsigned)(0.5
-                                               + pow((double)(found->dem->data[DEM_INDEX(
-                                                                  found->dem->ippd, x0, y0)]
+                                               + pow((double)(found->sample(x0, y0)
                                                               - out->min_elevation),
                                                      one_over_gamma)
                                                      * conversion);
@@ -897,7 +867,7 @@ void PathReport(Path const & path,
     angle1 = ElevationAngle(source, destination);
     angle2 = ElevationAngle2(path, source, destination, EARTHRADIUS_FT, lr);
 
-    if (G_got_azimuth_pattern || G_got_elevation_pattern) {
+    if (lr.got_azimuth_pattern || lr.got_elevation_pattern) {
         x = (int)rint(10.0 * (10.0 - angle2));
 
         if (x >= 0 && x <= 1000) {
@@ -1205,7 +1175,7 @@ void PathReport(Path const & path,
             cos_xmtr_angle = ((source_alt2) + (distance * distance) - (dest_alt2))
                              / (2.0 * source_alt * distance);
 
-            if (G_got_elevation_pattern) {
+            if (lr.got_elevation_pattern) {
                 /* If an antenna elevation pattern is available, the
                    following code determines the elevation angle to
                    the first obstruction along the path. */
@@ -0,0 +1,589 @@
+/*
+ * On-the-fly transcoding of legacy SPLAT! Data Files into BSDF.  An
+ * SDF is a text file of four header lines followed by one elevation
+ * per line, column by column, and is often shipped gzip or bzip2
+ * compressed.  Parsing one takes far longer than mapping a BSDF, so
+ * a tile found only as an SDF is decoded once into a BSDF v0 copy in
+ * the cache directory, and loaded from there from then on.
+ *
+ * Decompression and parsing run in a pipeline: a reader thread
+ * inflates the file a block at a time while the loading thread
+ * parses the blocks already inflated.  Tiles themselves are loaded
+ * in parallel by LoadTopoData(), so each of its loaders transcodes
+ * its own tiles concurrently.
+ *
+ * BSDF copies are written to a temporary file that is renamed over
+ * the final name once it is complete, so other threads and processes
+ * never map a partial tile, and concurrent transcodes of the same
+ * tile just replace each other's identical copies.
+ */
+#include "sdf.hh"
+
+#include <bzlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.hh"
+
+/* Text inflated by the reader and handed to the parser at a time */
+#define SDF_BLOCK_SIZE (1 << 20)
+
+/* Blocks the reader may get ahead of the parser */
+#define SDF_BLOCKS_AHEAD 4
+
+/* max_west, min_north, min_west and max_north precede the samples */
+#define SDF_HEADER_LINES 4
+
+namespace {
+enum sdf_format { SDF_PLAIN, SDF_GZIP, SDF_BZIP2 };
+
+/* Legacy files are looked for in this order */
+const struct {
+    const char * suffix;
+    enum sdf_format format;
+} G_formats[] = {
+    {".sdf", SDF_PLAIN},
+    {".sdf.gz", SDF_GZIP},
+    {".sdf.bz2", SDF_BZIP2},
+};
+
+std::mutex G_sdf_mtx;
+char G_cache_path[PATH_MAX];
+struct sdf_stats G_stats;
+
+/* Reads the text of a legacy file, decompressing it if need be. */
+class source {
+    enum sdf_format format;
+    int fd = -1;
+    gzFile gz = nullptr;
+    FILE * file = nullptr;
+    BZFILE * bz = nullptr;
+    bool done = false;
+
+  public:
+    /* Takes ownership of fd. */
+    int open(int fd, enum sdf_format format) {
+        this->format = format;
+
+        if (format == SDF_GZIP) {
+            if (!(gz = gzdopen(fd, "rb"))) {
+                close(fd);
+                return -ENOMEM;
+            }
+            gzbuffer(gz, 1 << 17);
+        } else if (format == SDF_BZIP2) {
+            int err;
+
+            if (!(file = fdopen(fd, "rb"))) {
+                err = errno;
+                close(fd);
+                return -err;
+            }
+
+            if (!(bz = BZ2_bzReadOpen(&err, file, 0, 0, NULL, 0))) {
+                return -ENOMEM;
+            }
+        } else {
+            this->fd = fd;
+        }
+
+        return 0;
+    }
+
+    /* Returns the number of bytes read into buf, 0 at the end of the
+       text, or a negative errno. */
+    ssize_t read(char * buf, size_t size) {
+        ssize_t n = 0;
+
+        if (done) {
+            return 0;
+        }
+
+        if (format == SDF_PLAIN) {
+            n = ::read(fd, buf, size);
+            return n == -1 ? -errno : n;
+        }
+
+        if (format == SDF_GZIP) {
+            int errnum;
+
+            n = gzread(gz, buf, size);
+
+            if (n < 0) {
+                gzerror(gz, &errnum);
+                return errnum == Z_ERRNO ? -errno : -EBADMSG;
+            }
+            return n;
+        }
+
+        int err;
+
+        n = BZ2_bzRead(&err, bz, buf, size);
+
+        if (err != BZ_OK && err != BZ_STREAM_END) {
+            return err == BZ_IO_ERROR ? -EIO : -EBADMSG;
+        }
+
+        /* Parallel bzip2 tools write a stream per block; carry on
+           into the next one until the file runs out. */
+        if (err == BZ_STREAM_END) {
+            char rest[BZ_MAX_UNUSED];
+            void * unused;
+            int count, c;
+
+            BZ2_bzReadGetUnused(&err, bz, &unused, &count);
+            memcpy(rest, unused, count);
+            BZ2_bzReadClose(&err, bz);
+            bz = nullptr;
+
+            if (count == 0 && (c = getc(file)) != EOF) {
+                ungetc(c, file);
+            } else if (count == 0) {
+                done = true;
+                return n;
+            }
+
+            if (!(bz = BZ2_bzReadOpen(&err, file, 0, 0, rest, count))) {
+                return -ENOMEM;
+            }
+        }
+
+        return n;
+    }
+
+    /* Returns how far into the file reading has got. */
+    unsigned long long offset() {
+        if (gz) {
+            return gzoffset(gz);
+        }
+        return file ? ftell(file) : lseek(fd, 0, SEEK_CUR);
+    }
+
+    ~source() {
+        int err;
+
+        if (gz) {
+            gzclose(gz);
+        }
+        if (bz) {
+            BZ2_bzReadClose(&err, bz);
+        }
+        if (file) {
+            fclose(file);
+        }
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+};
+
+/* Blocks of text on their way from the reader to the parser */
+struct pipeline {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::vector<char>> full;
+    std::vector<std::vector<char>> spare;
+    bool done = false;
+    bool cancel = false;
+    int error = 0;
+};
+
+/* Fills blocks from src until its text runs out, an error occurs or
+   the parser cancels. */
+void read_blocks(class source & src, struct pipeline & pipe) {
+    for (;;) {
+        std::vector<char> block;
+
+        {
+            std::unique_lock<std::mutex> lock(pipe.mtx);
+            pipe.cv.wait(lock, [&] {
+                return pipe.cancel || pipe.full.size() < SDF_BLOCKS_AHEAD;
+            });
+
+            if (pipe.cancel) {
+                return;
+            }
+
+            if (!pipe.spare.empty()) {
+                block = std::move(pipe.spare.back());
+                pipe.spare.pop_back();
+            }
+        }
+
+        size_t used = 0;
+        ssize_t n = 1;
+
+        block.resize(SDF_BLOCK_SIZE);
+
+        while (used < block.size()
+               && (n = src.read(&block[used], block.size() - used)) > 0) {
+            used += n;
+        }
+
+        block.resize(used);
+
+        std::lock_guard<std::mutex> lock(pipe.mtx);
+
+        if (used) {
+            pipe.full.push_back(std::move(block));
+        }
+
+        if (n <= 0) {
+            pipe.error = (int)n;
+            pipe.done = true;
+        }
+
+        pipe.cv.notify_all();
+
+        if (pipe.done) {
+            return;
+        }
+    }
+}
+
+/* Parses SDF text into row-major samples as it arrives. */
+struct parser {
+    std::vector<short> samples;
+    int ippd;
+    int x = 0;
+    int y = 0;
+    int lines = 0;
+    int value = 0;
+    bool negative = false;
+    bool digits = false;
+    bool bad = false;
+    size_t count = 0;
+    short min_el = SHRT_MAX;
+    short max_el = SHRT_MIN;
+
+    explicit parser(int ippd)
+        : samples((size_t)ippd * ippd), ippd(ippd) {}
+
+    /* The file holds the samples of each x in turn, y fastest. */
+    void emit() {
+        if (!digits) {
+            bad |= negative;
+            return;
+        }
+
+        if (count == samples.size() || value > SHRT_MAX) {
+            bad = true;
+        } else {
+            short el = (short)(negative ? -value : value);
+
+            samples[DEM_INDEX(ippd, x, y)] = el;
+            min_el = el < min_el ? el : min_el;
+            max_el = el > max_el ? el : max_el;
+            count++;
+
+            if (++y == ippd) {
+                y = 0;
+                x++;
+            }
+        }
+
+        value = 0;
+        negative = false;
+        digits = false;
+    }
+
+    void feed(const char * text, size_t size) {
+        size_t i = 0;
+
+        for (; i < size && lines < SDF_HEADER_LINES; i++) {
+            lines += text[i] == '\n';
+        }
+
+        for (; i < size; i++) {
+            char c = text[i];
+
+            if (c >= '0' && c <= '9') {
+                /* Saturate rather than overflow; emit() rejects it */
+                value = value > SHRT_MAX ? value : (value * 10) + (c - '0');
+                digits = true;
+            } else if (c == '-' && !digits && !negative) {
+                negative = true;
+            } else if (c == '\n' || c == '\r' || c == ' ' || c == '\t') {
+                emit();
+            } else {
+                bad = true;
+            }
+        }
+    }
+
+    bool complete() {
+        emit();
+        return !bad && count == samples.size();
+    }
+};
+
+/* Writes samples to path as a BSDF v0 tile, atomically. */
+int write_bsdf(const char * path, struct parser const & tile) {
+    char temp[PATH_MAX];
+    uint16_t footer[4] = {(uint16_t)tile.ippd,
+                          (uint16_t)tile.min_el,
+                          (uint16_t)tile.max_el,
+                          0};
+
+    if (snprintf(temp, sizeof(temp), "%s.XXXXXX", path) >= (int)sizeof(temp)) {
+        return -ENAMETOOLONG;
+    }
+
+    int fd = mkstemp(temp);
+
+    if (fd == -1) {
+        return -errno;
+    }
+
+    const char * data = (const char *)tile.samples.data();
+    size_t size = sizeof(short) * tile.samples.size();
+    int err = 0;
+
+    while (size && !err) {
+        ssize_t n = write(fd, data, size);
+
+        if (n == -1) {
+            err = errno == EINTR ? 0 : errno;
+        } else {
+            data += n;
+            size -= n;
+        }
+    }
+
+    if (!err && write(fd, footer, sizeof(footer)) != sizeof(footer)) {
+        err = errno ? errno : EIO;
+    }
+
+    /* Flush it before the rename makes it visible, so that a crash
+       can't leave a truncated tile that maps short. */
+    if (!err && (fchmod(fd, 0644) == -1 || fsync(fd) == -1)) {
+        err = errno;
+    }
+
+    if (close(fd) == -1 && !err) {
+        err = errno;
+    }
+
+    if (!err && rename(temp, path) == -1) {
+        err = errno;
+    }
+
+    if (err) {
+        unlink(temp);
+    }
+
+    return -err;
+}
+
+/* Opens the first legacy file for tile base in the working directory
+   or G_sdf_path, storing its path and format. */
+int find_legacy(const char * base,
+                char * path,
+                size_t size,
+                enum sdf_format * format) {
+    const char * dirs[] = {"", G_sdf_path};
+
+    for (const char * dir : dirs) {
+        for (auto const & legacy : G_formats) {
+            snprintf(path, size, "%s%s%s", dir, base, legacy.suffix);
+
+            int fd = open(path, O_RDONLY);
+
+            if (fd != -1) {
+                *format = legacy.format;
+                return fd;
+            }
+        }
+    }
+
+    return -ENOENT;
+}
+} // namespace
+
+/*
+ * sdf_set_cache_path
+ * Sets the directory that legacy tiles are transcoded into, creating
+ * it if need be.  Tiles go into G_sdf_path by default.  Set it
+ * before loading any tiles.  Returns 0 or a negative errno.
+ */
+int sdf_set_cache_path(const char * path) {
+    size_t len = strlen(path);
+
+    if (len == 0 || len + 2 > sizeof(G_cache_path)) {
+        return -EINVAL;
+    }
+
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+        return -errno;
+    }
+
+    std::lock_guard<std::mutex> lock(G_sdf_mtx);
+
+    snprintf(G_cache_path,
+             sizeof(G_cache_path),
+             "%s%s",
+             path,
+             path[len - 1] == '/' ? "" : "/");
+
+    return 0;
+}
+
+/*
+ * sdf_cache_path
+ * Returns the directory, with a trailing slash, that legacy tiles are
+ * transcoded into.  This is G_sdf_path itself unless one was set.
+ */
+const char * sdf_cache_path() {
+    return G_cache_path[0] ? G_cache_path : G_sdf_path;
+}
+
+/*
+ * sdf_transcode
+ * Looks for a legacy SDF, gzipped SDF or bzipped SDF of the tile name
+ * (as passed to LoadSDF()) and transcodes it into a BSDF in the cache
+ * directory.  Returns 0 once the BSDF is in place, -ENOENT if there is
+ * no legacy file either, or another negative errno.
+ */
+int sdf_transcode(const char * name) {
+    char base[255], legacy[PATH_MAX], bsdf[PATH_MAX];
+    int minlat, maxlat, minlon, maxlon;
+    enum sdf_format format;
+    size_t x;
+
+    for (x = 0; name[x] != '.' && name[x] != 0 && x < sizeof(base) - 1; x++) {
+        base[x] = name[x];
+    }
+
+    base[x] = 0;
+
+    if (sscanf(base, "%d:%d:%d:%d", &minlat, &maxlat, &minlon, &maxlon) != 4) {
+        return -EINVAL;
+    }
+
+    int fd = find_legacy(base, legacy, sizeof(legacy), &format);
+
+    if (fd < 0) {
+        return fd;
+    }
+
+    if (snprintf(bsdf, sizeof(bsdf), "%s%s.bsdf", sdf_cache_path(), base)
+        >= (int)sizeof(bsdf)) {
+        close(fd);
+        return -ENAMETOOLONG;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    struct parser tile(strstr(base, "-hd") ? 3600 : 1200);
+    struct pipeline pipe;
+    unsigned long long text_bytes = 0, read_bytes;
+    int err;
+
+    {
+        class source src;
+
+        if ((err = src.open(fd, format)) != 0) {
+            return err;
+        }
+
+        std::thread reader(read_blocks, std::ref(src), std::ref(pipe));
+
+        for (;;) {
+            std::vector<char> block;
+
+            {
+                std::unique_lock<std::mutex> lock(pipe.mtx);
+                pipe.cv.wait(lock,
+                             [&] { return pipe.done || !pipe.full.empty(); });
+
+                if (pipe.full.empty() || tile.bad) {
+                    pipe.cancel = true;
+                    pipe.cv.notify_all();
+                    break;
+                }
+
+                block = std::move(pipe.full.front());
+                pipe.full.pop_front();
+                pipe.cv.notify_all();
+            }
+
+            tile.feed(block.data(), block.size());
+            text_bytes += block.size();
+
+            std::lock_guard<std::mutex> lock(pipe.mtx);
+            pipe.spare.push_back(std::move(block));
+        }
+
+        reader.join();
+        read_bytes = src.offset();
+    }
+
+    if (pipe.error) {
+        err = pipe.error;
+    } else if (!tile.complete()) {
+        err = -EBADMSG;
+    } else {
+        err = write_bsdf(bsdf, tile);
+    }
+
+    if (err) {
+        fprintf(stderr,
+                "Can't transcode \"%s\" to \"%s\": %s\n",
+                legacy,
+                bsdf,
+                err == -EBADMSG ? "corrupt or truncated" : strerror(-err));
+        fflush(stderr);
+        return err;
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - started;
+
+    {
+        std::lock_guard<std::mutex> lock(G_sdf_mtx);
+        G_stats.tiles++;
+        G_stats.read_bytes += read_bytes;
+        G_stats.text_bytes += text_bytes;
+        G_stats.seconds += elapsed.count();
+    }
+
+    if (G_debug == 1) {
+        fprintf(stderr,
+                "Transcoded \"%s\" to \"%s\": %.1f MB of text from %.1f MB "
+                "in %.1f ms (%.1f MB/s, %.1f Msamples/s)\n",
+                legacy,
+                bsdf,
+                text_bytes / 1e6,
+                read_bytes / 1e6,
+                elapsed.count() * 1e3,
+                text_bytes / 1e6 / elapsed.count(),
+                tile.count / 1e6 / elapsed.count());
+        fflush(stderr);
+    }
+
+    return 0;
+}
+
+/*
+ * sdf_get_stats
+ * Copies out how many legacy tiles have been transcoded, the bytes
+ * read and the text they held, and the time spent transcoding them.
+ */
+void sdf_get_stats(struct sdf_stats * stats) {
+    std::lock_guard<std::mutex> lock(G_sdf_mtx);
+    *stats = G_stats;
+}
@@ -0,0 +1,19 @@
+#ifndef _SDF_HH_
+#define _SDF_HH_
+
+#include <stddef.h>
+
+/* Cumulative counters of legacy tiles transcoded to BSDF */
+struct sdf_stats {
+    unsigned long tiles;
+    unsigned long long read_bytes;
+    unsigned long long text_bytes;
+    double seconds;
+};
+
+int sdf_set_cache_path(const char * path);
+const char * sdf_cache_path();
+int sdf_transcode(const char * name);
+void sdf_get_stats(struct sdf_stats * stats);
+
+#endif /* _SDF_HH_ */
@@ -30,17 +30,22 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#include <algorithm>
 #include <cassert>
-#include <limits>
 #include <vector>
 
 #include "common.hh"
+#include "coverage.hh"
+#include "dem-cache.hh"
+#include "dem-catalog.hh"
+#include "great-circle.hh"
 #include "image.hh"
 #include "inputs.hh"
 #include "models/itwom3.0.hh"
 #include "models/los.hh"
 #include "models/pel.hh"
 #include "outputs.hh"
+#include "signal-server.hh"
 
 int MAXPAGES = 10 * 10;
 int IPPD = 1200;
@@ -52,15 +57,10 @@ int G_ippd, G_mpi, G_debug = 0;
 
 double G_dpp, G_ppd, G_yppd, G_fzone_clearance = 0.6, G_delta = 0;
 
-char * G_color_file = NULL;
+/* Each request picks its colours on the thread that handles it */
+thread_local char * G_color_file = NULL;
 
-unsigned char G_got_elevation_pattern, G_got_azimuth_pattern;
-
-std::shared_mutex G_dem_mtx;
-
-std::vector<std::shared_ptr<const struct dem>> G_dem;
-
-struct region G_region;
+thread_local struct region G_region;
 
 const char * version() {
     return "4.0.0";
@@ -162,51 +162,17 @@ int PutMask(struct output * out, double lat, double lon, int value) {
        bits in the mask based on the latitude and longitude of the
        area pointed to. */
 
-    int x = 0, y = 0;
-    struct dem_output * found = NULL;
-
-    for (auto & i : out->dem_out) {
-        x = (int)rint(G_ppd * (lat - i.min_north));
-        y = G_mpi - (int)rint(G_yppd * (LonDiff(i.max_west, lon)));
-
-        if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-            found = &i;
-            break;
-        }
-    }
-
-    // if we couldn't find it in the output vector, find the right DEM
-    // and create a corresponding output vector entry
-    if (!found) {
-        std::shared_lock r_lock(G_dem_mtx);
-        for (auto const & dem : G_dem) {
-            x = (int)rint(G_ppd * (lat - dem->min_north));
-            y = G_mpi - (int)rint(G_yppd * (LonDiff(dem->max_west, lon)));
-
-            if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-                struct dem_output tmp;
-                tmp.min_north = dem->min_north;
-                tmp.max_north = dem->max_north;
-                tmp.min_west = dem->min_west;
-                tmp.max_west = dem->max_west;
-                tmp.dem = dem;
-                tmp.mask.resize(dem->ippd * dem->ippd, 0);
-                tmp.signal.resize(dem->ippd * dem->ippd, 0);
-                out->dem_out.push_back(tmp);
-                found = &out->dem_out.back();
-                break;
-            }
-        }
-    }
+    coverage_fit(out);
 
-    if (found) {
-        found->mask[DEM_INDEX(found->dem->ippd, x, y)] = value;
-        return ((int)found->mask[DEM_INDEX(found->dem->ippd, x, y)]);
-    }
+    long pixel = coverage_pixel(out->coverage, lat, lon);
 
-    else {
+    if (pixel < 0) {
         return -1;
     }
+
+    out->coverage.mask[pixel].store(value, std::memory_order_relaxed);
+
+    return value & 0xff;
 }
 
 int OrMask(struct output * out, double lat, double lon, int value) {
@@ -216,80 +182,54 @@ int OrMask(struct output * out, double lat, double lon, int value) {
        the mask based on the latitude and longitude of the area
        pointed to. */
 
-    int x = 0, y = 0;
-    struct dem_output * found = NULL;
-
-    for (auto & i : out->dem_out) {
-        x = (int)rint(G_ppd * (lat - i.min_north));
-        y = G_mpi - (int)rint(G_yppd * (LonDiff(i.max_west, lon)));
-
-        if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-            found = &i;
-            break;
-        }
-    }
-
-    // if we couldn't find it in the output vector, find the right DEM
-    // and create a corresponding output vector entry
-    if (!found) {
-        std::shared_lock r_lock(G_dem_mtx);
-        for (auto const & dem : G_dem) {
-            x = (int)rint(G_ppd * (lat - dem->min_north));
-            y = G_mpi - (int)rint(G_yppd * (LonDiff(dem->max_west, lon)));
-
-            if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-                struct dem_output tmp;
-                tmp.min_north = dem->min_north;
-                tmp.max_north = dem->max_north;
-                tmp.min_west = dem->min_west;
-                tmp.max_west = dem->max_west;
-                tmp.dem = dem;
-                tmp.mask.resize(dem->ippd * dem->ippd, 0);
-                tmp.signal.resize(dem->ippd * dem->ippd, 0);
-                out->dem_out.push_back(tmp);
-                found = &out->dem_out.back();
-                break;
-            }
-        }
-    }
-
-    if (found) {
-        found->mask[DEM_INDEX(found->dem->ippd, x, y)] |= value;
-        return ((int)found->mask[DEM_INDEX(found->dem->ippd, x, y)]);
-    }
+    coverage_fit(out);
 
-    else {
-        return -1;
-    }
+    return UpdateMask(out, lat, lon, 0, value);
 }
 
 int GetMask(struct output * out, double lat, double lon) {
     /* This function returns the mask bits based on the latitude
        and longitude given. */
-    int x = 0, y = 0;
-    struct dem_output * found = NULL;
 
-    for (auto & i : out->dem_out) {
-        x = (int)rint(G_ppd * (lat - i.min_north));
-        y = G_mpi - (int)rint(G_yppd * (LonDiff(i.max_west, lon)));
+    long pixel = coverage_pixel(out->coverage, lat, lon);
 
-        if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-            found = &i;
-            break;
-        }
+    if (pixel < 0) {
+        return 0;
     }
 
-    if (found) {
-        return ((int)found->mask[DEM_INDEX(found->dem->ippd, x, y)]);
-    } else {
-        return 0;
+    return out->coverage.mask[pixel].load(std::memory_order_relaxed);
+}
+
+int UpdateMask(struct output * out,
+               double lat,
+               double lon,
+               int clear,
+               int set) {
+    /* This function clears the bits clear and then sets the
+       bits set in the mask at (lat, lon) as one atomic step,
+       and returns the new mask.  Unlike PutMask() and OrMask()
+       it never fits the coverage raster to newly pinned tiles,
+       so threads sweeping a plot can call it once the sweep
+       has. */
+
+    long pixel = coverage_pixel(out->coverage, lat, lon);
+
+    if (pixel < 0) {
+        return -1;
     }
+
+    auto & mask = out->coverage.mask[pixel];
+    unsigned char old = mask.load(std::memory_order_relaxed), value;
+
+    do {
+        value = (old & ~clear) | set;
+    } while (
+        !mask.compare_exchange_weak(old, value, std::memory_order_relaxed));
+
+    return value;
 }
 
 void PutSignal(struct output * out, double lat, double lon, unsigned char signal) {
-    int x = 0, y = 0;
-    struct dem_output * found = NULL;
-
     /* This function writes a signal level (0-255)
        at the specified location for later recall. */
 
@@ -297,48 +237,12 @@ void PutSignal(struct output * out, double lat, double lon, unsigned char signal
         out->hottest = signal;
     }
 
-    // lookup x/y for this co-ord
-    for (auto & i : out->dem_out) {
-        x = (int)rint(G_ppd * (lat - i.min_north));
-        y = G_mpi - (int)rint(G_yppd * (LonDiff(i.max_west, lon)));
-
-        if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-            found = &i;
-            break;
-        }
-    }
-
-    // if we couldn't find it in the output vector, find the right DEM
-    // and create a corresponding output vector entry
-    if (!found) {
-        std::shared_lock r_lock(G_dem_mtx);
-        for (auto const & dem : G_dem) {
-            x = (int)rint(G_ppd * (lat - dem->min_north));
-            y = G_mpi - (int)rint(G_yppd * (LonDiff(dem->max_west, lon)));
-
-            if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-                struct dem_output tmp;
-                tmp.min_north = dem->min_north;
-                tmp.max_north = dem->max_north;
-                tmp.min_west = dem->min_west;
-                tmp.max_west = dem->max_west;
-                tmp.dem = dem;
-                tmp.mask.resize(dem->ippd * dem->ippd, 0);
-                tmp.signal.resize(dem->ippd * dem->ippd);
-                out->dem_out.push_back(tmp);
-                found = &out->dem_out.back();
-                break;
-            }
-        }
-    }
+    coverage_fit(out);
 
-    if (found) { // Write values to file
-        found->signal[DEM_INDEX(found->dem->ippd, x, y)] = signal;
-        // return (dem[indx].signal[x][y]);
-        return;
-    } else {
-        // return 0;
-        return;
+    long pixel = coverage_pixel(out->coverage, lat, lon);
+
+    if (pixel >= 0) {
+        out->coverage.signal[pixel].store(signal, std::memory_order_relaxed);
     }
 }
 
@@ -347,25 +251,66 @@ unsigned char GetSignal(struct output * out, double lat, double lon) {
        specified location that was previously written by the
        complimentary PutSignal() function. */
 
-    int x = 0, y = 0;
-    struct dem_output * found = NULL;
+    long pixel = coverage_pixel(out->coverage, lat, lon);
 
-    // lookup x/y for this co-ord
-    for (auto & i : out->dem_out) {
-        x = (int)rint(G_ppd * (lat - i.min_north));
-        y = G_mpi - (int)rint(G_yppd * (LonDiff(i.max_west, lon)));
+    if (pixel < 0) {
+        return 0;
+    }
 
-        if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-            found = &i;
-            break;
-        }
+    return out->coverage.signal[pixel].load(std::memory_order_relaxed);
+}
+
+unsigned char MaxSignal(struct output * out,
+                        double lat,
+                        double lon,
+                        unsigned char signal) {
+    /* This function raises the signal level at (lat, lon) to
+       signal as one atomic step and returns the level it is
+       left at, or signal outside the coverage raster.  Like
+       UpdateMask(), it never fits the raster. */
+
+    long pixel = coverage_pixel(out->coverage, lat, lon);
+
+    if (pixel < 0) {
+        return signal;
     }
 
-    if (found) {
-        return (found->signal[DEM_INDEX(found->dem->ippd, x, y)]);
-    } else {
-        return 0;
+    auto & level = out->coverage.signal[pixel];
+    unsigned char old = level.load(std::memory_order_relaxed);
+
+    while (old < signal
+           && !level.compare_exchange_weak(old,
+                                           signal,
+                                           std::memory_order_relaxed)) {
     }
+
+    return MAX(old, signal);
+}
+
+unsigned char MinSignal(struct output * out,
+                        double lat,
+                        double lon,
+                        unsigned char loss) {
+    /* As MaxSignal(), but for path loss: the lower of loss
+       and what is at (lat, lon) is kept, unless nothing has
+       been written there yet. */
+
+    long pixel = coverage_pixel(out->coverage, lat, lon);
+
+    if (pixel < 0) {
+        return loss;
+    }
+
+    auto & level = out->coverage.signal[pixel];
+    unsigned char old = level.load(std::memory_order_relaxed);
+
+    while ((old == 0 || old > loss)
+           && !level.compare_exchange_weak(old,
+                                           loss,
+                                           std::memory_order_relaxed)) {
+    }
+
+    return (old == 0 || old > loss) ? loss : old;
 }
 
 double GetElevation(site const & location) {
@@ -373,28 +318,21 @@ double GetElevation(site const & location) {
        represented by the digital elevation model data in memory.
        Function returns -5000.0 for locations not found in memory. */
 
+    return GetElevation(*dem_cache_snapshot(), location);
+}
+
+double GetElevation(struct dem_snapshot const & tiles, site const & location) {
+    /* As above, but looks the location up in a snapshot of the
+       resident tiles that the caller holds across many calls. */
+
     int x = 0, y = 0;
-    std::shared_ptr<const dem> found;
-    {
-        std::shared_lock r_lock(G_dem_mtx);
-        for (auto const & dem : G_dem) {
-            x = (int)rint(G_ppd * (location.lat - dem->min_north));
-            y = G_mpi - (int)rint(G_yppd * (LonDiff(dem->max_west, location.lon)));
-
-            if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-                found = dem;
-                break;
-            }
-        }
-    }
+    const struct dem * found =
+        dem_snapshot_locate(tiles, location.lat, location.lon, x, y);
 
     double elevation;
-    if (found && found->data) {
-        elevation = FEET_PER_METER * found->data[DEM_INDEX(found->ippd, x, y)];
-    } else if (found) {
-        // If it's in memory but doesn't have any data, it was
-        // inserted as an ocean place-holder
-        elevation = 0.0;
+    if (found) {
+        // Ocean place-holders have no data and sample as 0
+        elevation = FEET_PER_METER * found->sample(x, y);
     } else {
         // Return an absurd value when this tile isn't in memory
         elevation = -5000.0;
@@ -403,6 +341,30 @@ double GetElevation(site const & location) {
     return elevation;
 }
 
+void GetElevations(struct dem_snapshot const & tiles,
+                   const double * lat,
+                   const double * lon,
+                   size_t count,
+                   double * elevation,
+                   bool bilinear) {
+    /* Fills elevation (in feet) for count locations at once,
+       with -5000.0 for those not found in memory.  Locations
+       in a run along the same tile share one tile lookup. */
+
+    dem_snapshot_sample(tiles,
+                        lat,
+                        lon,
+                        count,
+                        bilinear ? DEM_SAMPLE_BILINEAR : 0,
+                        elevation);
+
+    for (size_t i = 0; i < count; i++) {
+        elevation[i] = std::isnan(elevation[i])
+                         ? -5000.0
+                         : FEET_PER_METER * elevation[i];
+    }
+}
+
 int AddElevation(double lat, double lon, double height, int size) {
     /* This function adds a user-defined terrain feature
        (in meters AGL) to the digital elevation model data
@@ -410,19 +372,12 @@ int AddElevation(double lat, double lon, double height, int size) {
        not found in memory. */
 
     int i, j, x = 0, y = 0;
-    std::shared_ptr<const dem> found;
+    std::shared_ptr<const dem> found = dem_cache_locate(lat, lon, x, y);
 
-    {
-        std::shared_lock r_lock(G_dem_mtx);
-        for (auto const & dem : G_dem) {
-            x = (int)rint(G_ppd * (lat - dem->min_north));
-            y = G_mpi - (int)rint(G_yppd * (LonDiff(dem->max_west, lon)));
-
-            if (x >= 0 && x <= G_mpi && y >= 0 && y <= G_mpi) {
-                found = dem;
-                break;
-            }
-        }
+    // Compressed and uniform tiles, ocean place-holders among
+    // them, have no raw samples to edit in place
+    if (found && !found->data) {
+        found = nullptr;
     }
 
     if (found && size < 2)
@@ -556,6 +511,10 @@ double ElevationAngle(site const & source, site const & destination) {
 }
 
 Path::Path(site const & src, site const & dst) {
+    trace(src, dst);
+}
+
+void Path::trace(site const & src, site const & dst) {
     /* This function generates a sequence of latitude and
        longitude positions between source and destination
        locations along a great circle path, and stores
@@ -574,10 +533,8 @@ Path::Path(site const & src, site const & dst) {
         fflush(stderr);
     }
     int c;
-    double azimuth, distance_, lat1, lon1, beta, den, num, lat2, lon2,
-        total_distance, dx, dy, path_length, miles_per_sample,
-        samples_per_radian = 68755.0;
-    struct site tempsite;
+    double azimuth, lat1, lon1, lat2, lon2, total_distance, dx, dy,
+        path_length, miles_per_sample, samples_per_radian = 68755.0;
 
     lat1 = src.lat * DEG2RAD;
     lon1 = src.lon * DEG2RAD;
@@ -586,9 +543,6 @@ Path::Path(site const & src, site const & dst) {
     samples_per_radian = G_ppd * 57.295833;
     azimuth = Azimuth(src, dst) * DEG2RAD;
 
-    // printf("reading path  %f,%f - %f,%f\n", source.lat, source.lon,
-    // destination.lat, destination.lon);
-
     total_distance = Distance(src, dst);
 
     if (total_distance > (30.0 / G_ppd)) {
@@ -596,68 +550,43 @@ Path::Path(site const & src, site const & dst) {
         dy = samples_per_radian * acos(cos(lat1 - lat2));
         path_length = sqrt((dx * dx) + (dy * dy));
         miles_per_sample = total_distance / path_length;
-    }
-
-    else {
-        c = 0;
-        dx = 0.0;
-        dy = 0.0;
-        path_length = 0.0;
-        miles_per_sample = 0.0;
-        total_distance = 0.0;
 
-        lat1 = lat1 / DEG2RAD;
-        lon1 = lon1 / DEG2RAD;
+        /* Samples fall every miles_per_sample up to the destination */
+        c = (int)(total_distance / miles_per_sample);
 
-        lat.push_back(lat1);
-        lon.push_back(lon1);
-        elevation.push_back(GetElevation(src));
-        distance.push_back(0.0);
-    }
-
-    for (distance_ = 0.0, c = 0;
-         (total_distance != 0.0 && distance_ <= total_distance && c < ARRAYSIZE);
-         c++, distance_ = miles_per_sample * (double)c) {
-        beta = distance_ / 3959.0;
-        lat2 = asin(sin(lat1) * cos(beta) + cos(azimuth) * sin(beta) * cos(lat1));
-        num = cos(beta) - (sin(lat1) * sin(lat2));
-        den = cos(lat1) * cos(lat2);
-
-        if (azimuth == 0.0 && (beta > HALFPI - lat1)) {
-            lon2 = lon1 + PI;
-
-        } else if (azimuth == HALFPI && (beta > HALFPI + lat1)) {
-            lon2 = lon1 + PI;
-
-        } else if (fabs(num / den) > 1.0) {
-            lon2 = lon1;
-
-        } else {
-            if ((PI - azimuth) >= 0.0) {
-                lon2 = lon1 - arccos(num, den);
-            } else {
-                lon2 = lon1 + arccos(num, den);
-            }
+        while (miles_per_sample * (double)(c + 1) <= total_distance) {
+            c++;
         }
 
-        while (lon2 < 0.0) {
-            lon2 += TWOPI;
+        while (c >= 0 && miles_per_sample * (double)c > total_distance) {
+            c--;
         }
 
-        while (lon2 > TWOPI) {
-            lon2 -= TWOPI;
+        c = std::min(c + 1, ARRAYSIZE);
+
+        lat.resize(c);
+        lon.resize(c);
+        distance.resize(c);
+        great_circle_trace(lat1,
+                           lon1,
+                           azimuth,
+                           miles_per_sample / 3959.0,
+                           c,
+                           lat.data(),
+                           lon.data());
+
+        for (int i = 0; i < c; i++) {
+            distance[i] = miles_per_sample * (double)i;
         }
+    }
 
-        lat2 = lat2 / DEG2RAD;
-        lon2 = lon2 / DEG2RAD;
+    else {
+        c = 1;
+        total_distance = 0.0;
 
-        lat.push_back(lat2);
-        lon.push_back(lon2);
-        tempsite.lat = lat2;
-        tempsite.lon = lon2;
-        tempsite.alt = std::numeric_limits<float>::min();
-        elevation.push_back(GetElevation(tempsite));
-        distance.push_back(distance_);
+        lat.assign(1, src.lat);
+        lon.assign(1, src.lon);
+        distance.assign(1, 0.0);
     }
 
     /* Make sure exact destination point is recorded at path.length-1 */
@@ -665,14 +594,30 @@ Path::Path(site const & src, site const & dst) {
     if (c < ARRAYSIZE) {
         lat.push_back(dst.lat);
         lon.push_back(dst.lon);
-        elevation.push_back(GetElevation(dst));
         distance.push_back(total_distance);
         c++;
     }
+
+    /* Sample the whole path in one go; consecutive points mostly
+       fall in the same tile. */
+    elevation.resize(lat.size());
+    GetElevations(*dem_cache_snapshot(),
+                  lat.data(),
+                  lon.data(),
+                  lat.size(),
+                  elevation.data(),
+                  false);
     assert(lat.size() == lon.size() && lon.size() == elevation.size()
            && elevation.size() == distance.size());
 }
 
+void Path::reserve(size_t samples) {
+    lat.reserve(samples);
+    lon.reserve(samples);
+    elevation.reserve(samples);
+    distance.reserve(samples);
+}
+
 ssize_t Path::ssize() const {
     return lat.size();
 }
@@ -681,6 +626,88 @@ size_t Path::size() const {
     return lat.size();
 }
 
+PathPeaks::PathPeaks(Path const & path) {
+    build(path);
+}
+
+void PathPeaks::build(Path const & path) {
+    levels = 0;
+
+    do {
+        if (levels == level.size()) {
+            level.emplace_back();
+        }
+
+        std::vector<double> & peak = level[levels];
+
+        if (levels == 0) {
+            peak.assign(path.elevation.begin(), path.elevation.end());
+        } else {
+            std::vector<double> const & below = level[levels - 1];
+
+            peak.resize((below.size() + 1) / 2);
+
+            for (size_t i = 0; i < peak.size(); i++) {
+                peak[i] = 2 * i + 1 < below.size()
+                            ? MAX(below[2 * i], below[2 * i + 1])
+                            : below[2 * i];
+            }
+        }
+    } while (level[levels++].size() > 1);
+}
+
+void PathSight::start(double xmtr_alt, double earth, double clutter) {
+    this->xmtr_alt = xmtr_alt;
+    this->earth = earth;
+    this->clutter = clutter;
+    seen = 2;
+    rise_cos.clear();
+}
+
+void PathSight::reserve(size_t samples) {
+    rise_cos.reserve(samples);
+}
+
+double PathSight::elevation(Path const & path,
+                            ssize_t y,
+                            double dest_alt,
+                            bool & block) {
+    double xmtr_alt2 = xmtr_alt * xmtr_alt;
+
+    /* The cosine of the elevation angle at which the transmitter sees
+       a point distance feet out and alt feet from the centre */
+    auto cos_angle = [&](double distance, double alt) {
+        double c = ((xmtr_alt2) + (distance * distance) - (alt * alt))
+                   / (2.0 * xmtr_alt * distance);
+
+        return c > 1.0 ? 1.0 : c < -1.0 ? -1.0 : c;
+    };
+
+    for (; seen < y; seen++) {
+        double test_alt = earth
+                          + (path.elevation[seen] == 0.0
+                                 ? path.elevation[seen]
+                                 : path.elevation[seen] + clutter);
+        double c = cos_angle(FEET_PER_MILE * path.distance[seen], test_alt);
+
+        /* Since these are cosines, higher angles are smaller. */
+        if (rise_cos.empty() || c < rise_cos.back()) {
+            rise_cos.push_back(c);
+        }
+    }
+
+    double cos_rcvr_angle =
+        cos_angle(FEET_PER_MILE * path.distance[y], dest_alt);
+    auto first = std::partition_point(
+        rise_cos.begin(), rise_cos.end(), [&](double c) {
+            return c > cos_rcvr_angle;
+        });
+
+    block = first != rise_cos.end();
+
+    return ((acos(block ? *first : cos_rcvr_angle)) / DEG2RAD) - 90.0;
+}
+
 double ElevationAngle2(Path const & path,
                        site const & source,
                        site const & destination,
@@ -1078,10 +1105,6 @@ void resize_elev(struct output & out) {
 }
 
 int init(const char * sdf_path, bool debug) {
-    // Ensure we never to need resize G_dem by pre-allocing space for
-    // all 26109 files.
-    G_dem.reserve(26109);
-
     // these can stay globals
     G_gpsav = 0;
     G_sdf_path[0] = 0;
@@ -1097,6 +1120,7 @@ int init(const char * sdf_path, bool debug) {
 
     if (sdf_path) {
         strncpy(G_sdf_path, sdf_path, 253);
+        dem_catalog_scan();
         return 0;
     } else {
         return 1;
@@ -1114,7 +1138,8 @@ int handle_args(int argc, char * argv[], output & out) {
     double min_lat, min_lon, max_lat, max_lon, rxlat, rxlon, txlat, txlon,
         west_min, west_max, nortRxHin, nortRxHax;
 
-    bool use_threads = false;
+    /* Threads to sweep with; 0 = one per hardware thread */
+    int threads = 0;
 
     unsigned char LRmap = 0, txsites = 0, topomap = 0, geo = 0, kml = 0,
                   area_mode = 0, max_txsites, ngs = 0;
@@ -1156,6 +1181,12 @@ int handle_args(int argc, char * argv[], output & out) {
     lr.conf = 0.50;
     lr.rel = 0.50;
     lr.erp = 0.0; // will default to Path Loss
+    lr.overview_range = 0.0;
+    lr.overview_check = false;
+    lr.azimuth_bins = 0;
+    lr.compact_profile = false;
+    lr.got_azimuth_pattern = 0;
+    lr.got_elevation_pattern = 0;
 
     propmodel = 1; // ITM
     ngs = 1;       // no terrain background
@@ -1167,6 +1198,9 @@ int handle_args(int argc, char * argv[], output & out) {
     antenna_downtilt = 99.0; // don't mess with them!
     antenna_dt_direction = -1;
     antenna_file[0] = '\0';
+    lr.antenna_rotation = antenna_rotation;
+    lr.antenna_downtilt = antenna_downtilt;
+    lr.antenna_dt_direction = antenna_dt_direction;
 
     y = argc - 1;
 
@@ -1243,6 +1277,7 @@ int handle_args(int argc, char * argv[], output & out) {
                 if (antenna_rotation > 359.0) {
                     antenna_rotation = 0.0;
                 }
+                lr.antenna_rotation = antenna_rotation;
             }
         }
 
@@ -1257,6 +1292,7 @@ int handle_args(int argc, char * argv[], output & out) {
                 if (antenna_downtilt > 90.0) {
                     antenna_downtilt = 90.0;
                 }
+                lr.antenna_downtilt = antenna_downtilt;
             }
         }
 
@@ -1272,6 +1308,7 @@ int handle_args(int argc, char * argv[], output & out) {
                 if (antenna_dt_direction > 359.0) {
                     antenna_dt_direction = 0.0;
                 }
+                lr.antenna_dt_direction = antenna_dt_direction;
             }
         }
 
@@ -1610,7 +1647,48 @@ int handle_args(int argc, char * argv[], output & out) {
         if (strcmp(argv[x], "-nothreads") == 0) {
             z = x + 1;
             printf("disabling threads\n");
-            use_threads = false;
+            threads = 1;
+        }
+
+        // Threads to sweep with
+        if (strcmp(argv[x], "-threads") == 0) {
+            z = x + 1;
+            threads = 0;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                sscanf(argv[z], "%d", &threads);
+            }
+        }
+
+        // Terrain overviews beyond this range
+        if (strcmp(argv[x], "-ovr") == 0) {
+            z = x + 1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                sscanf(argv[z], "%lf", &lr.overview_range);
+            }
+        }
+
+        // Report overview deviation from full resolution
+        if (strcmp(argv[x], "-ovrchk") == 0) {
+            z = x + 1;
+            lr.overview_check = true;
+        }
+
+        // Radials share a path per bin of azimuth
+        if (strcmp(argv[x], "-azbins") == 0) {
+            z = x + 1;
+            lr.azimuth_bins = -1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                sscanf(argv[z], "%d", &lr.azimuth_bins);
+            }
+        }
+
+        // Terrain profiles in float for ITM/ITWOM
+        if (strcmp(argv[x], "-cpfl") == 0) {
+            z = x + 1;
+            lr.compact_profile = true;
         }
 
         // Reliability % for ITM model
@@ -1710,6 +1788,7 @@ int handle_args(int argc, char * argv[], output & out) {
     if (lr.metric) {
         altitudeLR /= METERS_PER_FOOT; /* 10ft * 0.3 = 3.3m */
         lr.max_range /= KM_PER_MILE;   /* 10 / 1.6 = 7.5 */
+        lr.overview_range /= KM_PER_MILE;
         altitude /= METERS_PER_FOOT;
         out.tx_site[0].alt /= METERS_PER_FOOT; /* Feet to metres */
         out.tx_site[1].alt /= METERS_PER_FOOT; /* Feet to metres */
@@ -1821,7 +1900,9 @@ int handle_args(int argc, char * argv[], output & out) {
 
     // max_lon-=3;
 
-    if ((result = LoadTopoData(max_lon, min_lon, max_lat, min_lat, &out)) != 0) {
+    result = LoadTopoData(max_lon, min_lon, max_lat, min_lat, &out, ppa == 0);
+
+    if (result != 0) {
         // This only fails on errors loading SDF tiles
         fprintf(stderr, "Error loading topo data\n");
         return result;
@@ -1921,7 +2002,10 @@ int handle_args(int argc, char * argv[], output & out) {
 
         /* Load any additional SDF files, if required */
 
-        if ((result = LoadTopoData(max_lon, min_lon, max_lat, min_lat, &out)) != 0) {
+        result = LoadTopoData(
+            max_lon, min_lon, max_lat, min_lat, &out, ppa == 0);
+
+        if (result != 0) {
             // This only fails on errors loading SDF tiles
             fprintf(stderr, "Error loading topo data\n");
             return result;
@@ -1956,7 +2040,7 @@ int handle_args(int argc, char * argv[], output & out) {
             cropping =
                 false; // TODO: File is written in DoLOS() so this needs moving
                        // to PlotPropagation() to allow styling, cropping etc
-            PlotLOSMap(&out, out.tx_site[0], altitudeLR, NULL, use_threads, &lr);
+            PlotLOSMap(&out, out.tx_site[0], altitudeLR, NULL, threads, &lr);
             DoLOS(&out, kml, ngs, out.tx_site);
         } else {
             // 90% of effort here
@@ -1968,7 +2052,7 @@ int handle_args(int argc, char * argv[], output & out) {
                             knifeedge,
                             haf,
                             pmenv,
-                            use_threads,
+                            threads,
                             &lr);
 
             if (G_debug) {
@@ -2059,7 +2143,11 @@ int handle_args(int argc, char * argv[], output & out) {
             fprintf(stderr, "\n");
         }
     } else {
+        struct dem_faults mark;
+
+        dem_cache_thread_faults(&mark);
         Path path(out.tx_site[0], out.tx_site[1]);
+        dem_cache_count_faults(&out.dem_faults, mark);
         strncpy(out.tx_site[0].name, "Tx", 3);
         strncpy(out.tx_site[1].name, "Rx", 3);
         /* TODO:  refactor PathReport so overall loss can be calculated without all the IO noise. */
@@ -2076,6 +2164,13 @@ int handle_args(int argc, char * argv[], output & out) {
         PlotPath(path, &out, out.tx_site[0], out.tx_site[1], 1, &lr);
         SeriesData(path, out.tx_site[0], out.tx_site[1], fresnel_plot, normalise, &out, lr);
     }
+
+    if (G_debug) {
+        fprintf(stderr,
+                "Terrain page faults: %lu minor, %lu major\n",
+                out.dem_faults.minor,
+                out.dem_faults.major);
+    }
     fflush(stderr);
 
     return 0;
@@ -2095,6 +2190,20 @@ int scan_stdin() {
         argv[argc] = NULL;
         output out;
         handle_args(argc, argv, out);
+
+        if (G_debug) {
+            struct dem_cache_stats stats;
+            dem_cache_get_stats(&stats);
+            fprintf(stderr,
+                    "Tile cache: %zu tiles, %zu MB, %lu hits, %lu misses, "
+                    "%lu evictions\n",
+                    stats.tiles,
+                    stats.bytes >> 20,
+                    stats.hits,
+                    stats.misses,
+                    stats.evictions);
+            fflush(stderr);
+        }
     }
     return 1;
 }
@@ -5,6 +5,8 @@
 
 #include "common.hh"
 
+struct dem_snapshot;
+
 int ReduceAngle(double angle);
 double LonDiff(double lon1, double lon2);
 void * dec2dms(double decimal, char * string);
@@ -13,7 +15,23 @@ int OrMask(struct output * out, double lat, double lon, int value);
 int GetMask(struct output * out, double lat, double lon);
 void PutSignal(struct output * out, double lat, double lon, unsigned char signal);
 unsigned char GetSignal(struct output * out, double lat, double lon);
+int UpdateMask(struct output * out, double lat, double lon, int clear, int set);
+unsigned char MaxSignal(struct output * out,
+                        double lat,
+                        double lon,
+                        unsigned char signal);
+unsigned char MinSignal(struct output * out,
+                        double lat,
+                        double lon,
+                        unsigned char loss);
 double GetElevation(site const & location);
+double GetElevation(struct dem_snapshot const & tiles, site const & location);
+void GetElevations(struct dem_snapshot const & tiles,
+                   const double * lat,
+                   const double * lon,
+                   size_t count,
+                   double * elevation,
+                   bool bilinear);
 int AddElevation(double lat, double lon, double height, int size);
 double Distance(site const & site1, site const & site2);
 double Azimuth(site const & source, site const & destination);